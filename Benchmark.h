@@ -0,0 +1,334 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "camera.h"
+#include "Surface.h"
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cmath>
+
+//Framebuffer object with a color and a depth renderbuffer, drawn into when there is no window
+class OffscreenTarget
+{
+	public:
+	OffscreenTarget():framebuffer(0), color(0), depth(0), width(0), height(0)
+	{}
+
+	~OffscreenTarget()
+	{
+		release();
+	}
+
+	//Deletes the framebuffer, with the GL context still current
+	void release()
+	{
+		if(framebuffer != 0)
+		{
+			glDeleteFramebuffers(1, &framebuffer);
+			glDeleteRenderbuffers(1, &color);
+			glDeleteRenderbuffers(1, &depth);
+		}
+		framebuffer = 0;
+	}
+
+	bool create(const int width, const int height)
+	{
+		this->width = width;
+		this->height = height;
+		glGenRenderbuffers(1, &color);
+		glBindRenderbuffer(GL_RENDERBUFFER, color);
+		glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+		glGenRenderbuffers(1, &depth);
+		glBindRenderbuffer(GL_RENDERBUFFER, depth);
+		glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+
+		glGenFramebuffers(1, &framebuffer);
+		glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+		glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, color);
+		glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depth);
+		if(glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+		{
+			std::cout << "Offscreen framebuffer incomplete" << std::endl;
+			return false;
+		}
+		glViewport(0, 0, width, height);
+		return true;
+	}
+
+	//RGB rows from the top one, as images are stored
+	void readPixels(std::vector<unsigned char>& pixels)
+	{
+		const int rowSize = width * 3;
+		std::vector<unsigned char> flipped(rowSize * height);
+		glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+		glPixelStorei(GL_PACK_ALIGNMENT, 1);
+		glReadPixels(0, 0, width, height, GL_RGB, GL_UNSIGNED_BYTE, &flipped[0]);
+		pixels.resize(flipped.size());
+		for(int row=0; row<height; row++)
+		{
+			std::copy(flipped.begin() + (height - 1 - row) * rowSize, flipped.begin() + (height - row) * rowSize, pixels.begin() + row * rowSize);
+		}
+	}
+
+	unsigned int getFramebuffer()
+	{
+		return framebuffer;
+	}
+
+	int getWidth()
+	{
+		return width;
+	}
+
+	int getHeight()
+	{
+		return height;
+	}
+
+	private:
+		unsigned int framebuffer;
+		unsigned int color;
+		unsigned int depth;
+		int width;
+		int height;
+};
+
+//Writes an RGB image as a PNG with uncompressed deflate blocks: bigger files than a real encoder, but exact pixels
+//for diffing and no library needed
+class PngWriter
+{
+	public:
+	static bool write(const std::string& path, const std::vector<unsigned char>& pixels, const int width, const int height)
+	{
+		//every row starts with filter type 0
+		std::vector<unsigned char> raw;
+		raw.reserve((width * 3 + 1) * height);
+		for(int row=0; row<height; row++)
+		{
+			raw.push_back(0);
+			raw.insert(raw.end(), pixels.begin() + row * width * 3, pixels.begin() + (row + 1) * width * 3);
+		}
+
+		std::vector<unsigned char> header;
+		putBig(header, width);
+		putBig(header, height);
+		//8 bits per channel, RGB, deflate, standard filters, not interlaced
+		header.push_back(8);
+		header.push_back(2);
+		header.push_back(0);
+		header.push_back(0);
+		header.push_back(0);
+
+		std::vector<unsigned char> data;
+		data.push_back(0x78);
+		data.push_back(0x01);
+		const size_t blockSize = 65535;
+		for(size_t position=0; position<raw.size() || position==0; position+=blockSize)
+		{
+			const size_t length = std::min(blockSize, raw.size() - position);
+			data.push_back(position + length == raw.size() ? 1 : 0);
+			data.push_back(length & 0xFF);
+			data.push_back(length >> 8);
+			data.push_back(~length & 0xFF);
+			data.push_back((~length >> 8) & 0xFF);
+			data.insert(data.end(), raw.begin() + position, raw.begin() + position + length);
+		}
+		putBig(data, adler32(raw));
+
+		std::ofstream file(path.c_str(), std::ios::binary);
+		const unsigned char signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+		file.write((const char*)signature, 8);
+		writeChunk(file, "IHDR", header);
+		writeChunk(file, "IDAT", data);
+		writeChunk(file, "IEND", std::vector<unsigned char>());
+		if(!file)
+		{
+			std::cout << "Failed to write image at path: " << path << std::endl;
+			return false;
+		}
+		return true;
+	}
+
+	private:
+		static void putBig(std::vector<unsigned char>& bytes, const unsigned int value)
+		{
+			bytes.push_back(value >> 24);
+			bytes.push_back((value >> 16) & 0xFF);
+			bytes.push_back((value >> 8) & 0xFF);
+			bytes.push_back(value & 0xFF);
+		}
+
+		static unsigned int adler32(const std::vector<unsigned char>& bytes)
+		{
+			unsigned int a = 1;
+			unsigned int b = 0;
+			for(size_t i=0; i<bytes.size(); i++)
+			{
+				a = (a + bytes[i]) % 65521;
+				b = (b + a) % 65521;
+			}
+			return (b << 16) | a;
+		}
+
+		static unsigned int crc32(const unsigned char* bytes, const size_t size, unsigned int crc)
+		{
+			static unsigned int table[256] = {0};
+			if(table[1] == 0)
+			{
+				for(unsigned int n=0; n<256; n++)
+				{
+					unsigned int c = n;
+					for(int k=0; k<8; k++)
+					{
+						c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+					}
+					table[n] = c;
+				}
+			}
+			for(size_t i=0; i<size; i++)
+			{
+				crc = table[(crc ^ bytes[i]) & 0xFF] ^ (crc >> 8);
+			}
+			return crc;
+		}
+
+		static void writeChunk(std::ofstream& file, const char* type, const std::vector<unsigned char>& data)
+		{
+			std::vector<unsigned char> length;
+			putBig(length, data.size());
+			file.write((const char*)&length[0], 4);
+			file.write(type, 4);
+			if(!data.empty())
+			{
+				file.write((const char*)&data[0], data.size());
+			}
+			unsigned int crc = crc32((const unsigned char*)type, 4, 0xFFFFFFFFu);
+			crc = data.empty() ? crc : crc32(&data[0], data.size(), crc);
+			std::vector<unsigned char> end;
+			putBig(end, crc ^ 0xFFFFFFFFu);
+			file.write((const char*)&end[0], 4);
+		}
+};
+
+//Time and triangles of every measured frame, summarized as JSON for comparing runs
+class BenchmarkStats
+{
+	public:
+	BenchmarkStats():depthPrepass(false), fragmentsPerPixel(0.0), occlusionCulling(false), testedChunks(0.0), culledChunks(0.0)
+	{}
+
+	void addFrame(const double milliseconds, const unsigned long long triangles)
+	{
+		frameTimes.push_back(milliseconds);
+		frameTriangles.push_back(triangles);
+	}
+
+	//Shaded fragments per pixel of the measured frames, and whether a depth pre-pass drew them
+	void setOverdraw(const bool prepass, const double factor)
+	{
+		depthPrepass = prepass;
+		fragmentsPerPixel = factor;
+	}
+
+	//Chunks tested and culled per frame by the occlusion culling, and whether it was on
+	void setOcclusion(const bool culling, const double tested, const double culled)
+	{
+		occlusionCulling = culling;
+		testedChunks = tested;
+		culledChunks = culled;
+	}
+
+	bool writeJson(const std::string& path, const std::string& scene, const int width, const int height, const std::string& renderer)
+	{
+		std::vector<double> sorted(frameTimes);
+		std::sort(sorted.begin(), sorted.end());
+		double totalTime = 0.0;
+		unsigned long long totalTriangles = 0;
+		for(unsigned int f=0; f<frameTimes.size(); f++)
+		{
+			totalTime += frameTimes[f];
+			totalTriangles += frameTriangles[f];
+		}
+		const double frames = std::max<size_t>(frameTimes.size(), 1);
+
+		std::ofstream file(path.c_str());
+		file << std::fixed << std::setprecision(3);
+		file << "{" << std::endl;
+		file << "  \"scene\": \"" << scene << "\"," << std::endl;
+		file << "  \"renderer\": \"" << renderer << "\"," << std::endl;
+		file << "  \"width\": " << width << "," << std::endl;
+		file << "  \"height\": " << height << "," << std::endl;
+		file << "  \"frames\": " << frameTimes.size() << "," << std::endl;
+		file << "  \"frameTimeMs\": {" << std::endl;
+		file << "    \"min\": " << percentile(sorted, 0.0) << "," << std::endl;
+		file << "    \"median\": " << percentile(sorted, 0.5) << "," << std::endl;
+		file << "    \"mean\": " << totalTime / frames << "," << std::endl;
+		file << "    \"p95\": " << percentile(sorted, 0.95) << "," << std::endl;
+		file << "    \"p99\": " << percentile(sorted, 0.99) << "," << std::endl;
+		file << "    \"max\": " << percentile(sorted, 1.0) << std::endl;
+		file << "  }," << std::endl;
+		file << "  \"depthPrepass\": " << (depthPrepass ? "true" : "false") << "," << std::endl;
+		file << "  \"shadedFragmentsPerPixel\": " << fragmentsPerPixel << "," << std::endl;
+		file << "  \"occlusionCulling\": " << (occlusionCulling ? "true" : "false") << "," << std::endl;
+		file << "  \"occlusionTestedChunksPerFrame\": " << testedChunks << "," << std::endl;
+		file << "  \"occlusionCulledChunksPerFrame\": " << culledChunks << "," << std::endl;
+		file << "  \"trianglesPerFrame\": " << totalTriangles / frames << "," << std::endl;
+		file << "  \"trianglesPerSecond\": " << (totalTime > 0.0 ? totalTriangles / (totalTime / 1000.0) : 0.0) << std::endl;
+		file << "}" << std::endl;
+		if(!file)
+		{
+			std::cout << "Failed to write benchmark results at path: " << path << std::endl;
+			return false;
+		}
+
+		std::cout << std::fixed << std::setprecision(2) << "Benchmark " << scene << ": " << frameTimes.size() << " frames, median "
+			<< percentile(sorted, 0.5) << " ms, p99 " << percentile(sorted, 0.99) << " ms, " << fragmentsPerPixel << " shaded fragments per pixel, "
+			<< culledChunks << " of " << testedChunks << " chunks occluded" << std::endl;
+		std::cout << std::defaultfloat << std::setprecision(6);
+		return true;
+	}
+
+	private:
+		std::vector<double> frameTimes;
+		std::vector<unsigned long long> frameTriangles;
+		bool depthPrepass;
+		double fragmentsPerPixel;
+		bool occlusionCulling;
+		double testedChunks;
+		double culledChunks;
+
+		//Nearest rank
+		static double percentile(const std::vector<double>& sorted, const double fraction)
+		{
+			if(sorted.empty())
+			{
+				return 0.0;
+			}
+			const int rank = std::ceil(fraction * sorted.size()) - 1;
+			return sorted[std::min(std::max(rank, 0), (int)sorted.size() - 1)];
+		}
+};
+
+//Scripted path for the benchmark: one turn around the centre of the surface, from above its highest point, looking at
+//the centre. t goes from 0 to 1. The surface is drawn translated down by its drop height, so its top is at 0
+inline void orbitCamera(Camera& camera, Surface& surface, const float t)
+{
+	const float width = surface.getColumns() * surface.getCellSize();
+	const float depth = surface.getRows() * surface.getCellSize();
+	const float extent = std::max(width, depth);
+	const glm::vec3 centre(width / 2.0f, -surface.getDropHeight() / 2.0f, depth / 2.0f);
+
+	const float angle = glm::radians(t * 360.0f);
+	camera.Position = centre + glm::vec3(std::cos(angle) * extent * 0.6f, surface.getDropHeight() / 2.0f + extent * 0.25f, std::sin(angle) * extent * 0.6f);
+	const glm::vec3 direction = glm::normalize(centre - camera.Position);
+	camera.setOrientation(glm::degrees(std::atan2(direction.z, direction.x)), glm::degrees(std::asin(direction.y)));
+}
+
+#endif
@@ -0,0 +1,167 @@
+#ifndef CAMERAPATH_H
+#define CAMERAPATH_H
+
+#include <glm/glm.hpp>
+
+#include "camera.h"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+struct CameraKey
+{
+	//seconds since the start of the recording
+	float time;
+	glm::vec3 position;
+	float yaw;
+	float pitch;
+	float zoom;
+};
+
+//Camera states recorded frame by frame, saved as text one key per line, and replayed at any time between the keys
+//through a cubic spline, so that a replay at a fixed step shows the same views whatever the frame rate of the recording
+class CameraPath
+{
+	public:
+	void clear()
+	{
+		keys.clear();
+	}
+
+	//Keys must be added with increasing times, closer ones than a millisecond are dropped
+	void record(const Camera& camera, const float time)
+	{
+		if(!keys.empty() && time - keys.back().time < 0.001f)
+		{
+			return;
+		}
+		CameraKey key;
+		key.time = time;
+		key.position = camera.Position;
+		key.yaw = camera.Yaw;
+		key.pitch = camera.Pitch;
+		key.zoom = camera.Zoom;
+		keys.push_back(key);
+	}
+
+	bool save(const std::string& path)
+	{
+		std::ofstream file(path.c_str());
+		file << "# time x y z yaw pitch zoom" << std::endl;
+		file.precision(9);
+		for(unsigned int k=0; k<keys.size(); k++)
+		{
+			file << keys[k].time << " " << keys[k].position.x << " " << keys[k].position.y << " " << keys[k].position.z << " "
+				<< keys[k].yaw << " " << keys[k].pitch << " " << keys[k].zoom << std::endl;
+		}
+		if(!file)
+		{
+			std::cout << "Failed to write camera path at path: " << path << std::endl;
+			return false;
+		}
+		std::cout << "Camera path of " << keys.size() << " keys, " << getDuration() << " s, saved at path: " << path << std::endl;
+		return true;
+	}
+
+	bool load(const std::string& path)
+	{
+		keys.clear();
+		std::ifstream file(path.c_str());
+		if(!file)
+		{
+			std::cout << "Failed to read camera path at path: " << path << std::endl;
+			return false;
+		}
+		std::string line;
+		while(std::getline(file, line))
+		{
+			if(line.empty() || line[0] == '#')
+			{
+				continue;
+			}
+			std::istringstream values(line);
+			CameraKey key;
+			if(!(values >> key.time >> key.position.x >> key.position.y >> key.position.z >> key.yaw >> key.pitch >> key.zoom)
+				|| (!keys.empty() && key.time <= keys.back().time))
+			{
+				std::cout << "Invalid camera path at path: " << path << ", line: " << line << std::endl;
+				keys.clear();
+				return false;
+			}
+			keys.push_back(key);
+		}
+		return !keys.empty();
+	}
+
+	bool isEmpty()
+	{
+		return keys.empty();
+	}
+
+	float getDuration()
+	{
+		return keys.empty() ? 0.0f : keys.back().time - keys.front().time;
+	}
+
+	//Puts the camera where the path is time seconds after its first key, held at the ends
+	void apply(Camera& camera, float time)
+	{
+		if(keys.empty())
+		{
+			return;
+		}
+		time = std::min(std::max(time + keys.front().time, keys.front().time), keys.back().time);
+		//last key not after time
+		int k = std::upper_bound(keys.begin(), keys.end(), time, [](const float t, const CameraKey& key){ return t < key.time; }) - keys.begin() - 1;
+		k = std::min(std::max(k, 0), (int)keys.size() - 1);
+
+		CameraKey sample;
+		if(k + 1 >= (int)keys.size())
+		{
+			sample = keys[k];
+		}
+		else
+		{
+			const float t = (time - keys[k].time) / (keys[k + 1].time - keys[k].time);
+			sample.position = spline(k, t, [](const CameraKey& key){ return key.position; });
+			glm::vec3 angles = spline(k, t, [](const CameraKey& key){ return glm::vec3(key.yaw, key.pitch, key.zoom); });
+			sample.yaw = angles.x;
+			sample.pitch = std::min(std::max(angles.y, -89.0f), 89.0f);
+			sample.zoom = std::min(std::max(angles.z, 1.0f), 45.0f);
+		}
+
+		camera.Position = sample.position;
+		camera.Zoom = sample.zoom;
+		camera.setOrientation(sample.yaw, sample.pitch);
+	}
+
+	private:
+		std::vector<CameraKey> keys;
+
+		//Cubic Hermite between key k and k + 1 at t from 0 to 1, with the Catmull-Rom tangents for uneven key times:
+		//the slope between the neighbouring keys, one sided at the ends
+		template <typename Value>
+		glm::vec3 spline(const int k, const float t, Value value)
+		{
+			const float duration = keys[k + 1].time - keys[k].time;
+			const glm::vec3 p0 = value(keys[k]);
+			const glm::vec3 p1 = value(keys[k + 1]);
+			const glm::vec3 m0 = slope(std::max(k - 1, 0), k + 1, value) * duration;
+			const glm::vec3 m1 = slope(k, std::min(k + 2, (int)keys.size() - 1), value) * duration;
+
+			const float t2 = t * t;
+			const float t3 = t2 * t;
+			return (2.0f * t3 - 3.0f * t2 + 1.0f) * p0 + (t3 - 2.0f * t2 + t) * m0 + (-2.0f * t3 + 3.0f * t2) * p1 + (t3 - t2) * m1;
+		}
+
+		template <typename Value>
+		glm::vec3 slope(const int from, const int to, Value value)
+		{
+			return (value(keys[to]) - value(keys[from])) / (keys[to].time - keys[from].time);
+		}
+};
+
+#endif
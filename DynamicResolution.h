@@ -0,0 +1,165 @@
+#ifndef DYNAMICRESOLUTION_H
+#define DYNAMICRESOLUTION_H
+
+#include <glad/glad.h>
+
+#include "Benchmark.h"
+#include <iostream>
+#include <algorithm>
+#include <cmath>
+
+//Frames timed on the GPU in flight before their times are read, without ever waiting for them
+const int RESOLUTION_QUERY_FRAMES = 4;
+//Smallest fraction of the window width and height drawn
+const float RESOLUTION_MIN_SCALE = 0.5f;
+//Largest raise of the scale per frame, lowering it is immediate
+const float RESOLUTION_SCALE_STEP = 0.02f;
+
+//Draws the frames into a framebuffer object at a fraction of the window size, then scales them up to the window.
+//The GPU time of every frame, read back with timestamp queries, gives what the frame would have cost at full size if
+//the time goes with the number of pixels, and the fraction is set for that cost to meet the target. The framebuffer
+//keeps the window size, only the viewport drawn into shrinks
+class DynamicResolution
+{
+	public:
+	DynamicResolution():targetMilliseconds(16.7f), scale(1.0f), drawnScale(1.0f), fullMilliseconds(0.0f), width(0), height(0), next(0), timing(false)
+	{
+		std::fill(pending, pending + RESOLUTION_QUERY_FRAMES, false);
+	}
+
+	//With the GL context current, for the size of the window framebuffer
+	bool create(const int windowWidth, const int windowHeight, const float milliseconds)
+	{
+		targetMilliseconds = milliseconds;
+		glGenQueries(2 * RESOLUTION_QUERY_FRAMES, &queries[0][0]);
+		return resize(windowWidth, windowHeight);
+	}
+
+	bool resize(const int windowWidth, const int windowHeight)
+	{
+		width = windowWidth;
+		height = windowHeight;
+		target.release();
+		bool complete = target.create(width, height);
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		return complete;
+	}
+
+	//Deletes the framebuffer and the queries, with the GL context still current
+	void release()
+	{
+		target.release();
+		glDeleteQueries(2 * RESOLUTION_QUERY_FRAMES, &queries[0][0]);
+	}
+
+	//Binds the framebuffer with the viewport of the current scale, or of the whole window for a frame meant to stay
+	//on screen, like the one after the camera stops
+	void begin(const bool full)
+	{
+		collect();
+		drawnScale = full ? 1.0f : scale;
+		glBindFramebuffer(GL_FRAMEBUFFER, target.getFramebuffer());
+		glViewport(0, 0, getRenderWidth(), getRenderHeight());
+		timing = !pending[next];
+		if(timing)
+		{
+			glQueryCounter(queries[next][0], GL_TIMESTAMP);
+		}
+	}
+
+	//Scales the drawn part of the framebuffer up to the window
+	void end()
+	{
+		if(timing)
+		{
+			glQueryCounter(queries[next][1], GL_TIMESTAMP);
+			pending[next] = true;
+			scales[next] = drawnScale;
+			next = (next + 1) % RESOLUTION_QUERY_FRAMES;
+		}
+		glBindFramebuffer(GL_READ_FRAMEBUFFER, target.getFramebuffer());
+		glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+		glBlitFramebuffer(0, 0, getRenderWidth(), getRenderHeight(), 0, 0, width, height, GL_COLOR_BUFFER_BIT, drawnScale < 1.0f ? GL_LINEAR : GL_NEAREST);
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		glViewport(0, 0, width, height);
+	}
+
+	//Whether the last frame was drawn below the window size, to be drawn again whole once the view is still
+	bool isReduced()
+	{
+		return drawnScale < 1.0f;
+	}
+
+	int getRenderWidth()
+	{
+		return std::max(1, (int)(width * drawnScale + 0.5f));
+	}
+
+	int getRenderHeight()
+	{
+		return std::max(1, (int)(height * drawnScale + 0.5f));
+	}
+
+	float getScale()
+	{
+		return scale;
+	}
+
+	private:
+		OffscreenTarget target;
+		float targetMilliseconds;
+		//for the next frames, and of the last one begun
+		float scale;
+		float drawnScale;
+		//estimated cost of a frame at the window size, averaged over the last frames
+		float fullMilliseconds;
+		int width;
+		int height;
+
+		unsigned int queries[RESOLUTION_QUERY_FRAMES][2];
+		float scales[RESOLUTION_QUERY_FRAMES];
+		bool pending[RESOLUTION_QUERY_FRAMES];
+		int next;
+		bool timing;
+
+		//Reads the frames finished on the GPU, oldest first, and sets the scale from them
+		void collect()
+		{
+			for(int q=0; q<RESOLUTION_QUERY_FRAMES; q++)
+			{
+				const int query = (next + q) % RESOLUTION_QUERY_FRAMES;
+				if(!pending[query])
+				{
+					continue;
+				}
+				GLint available = 0;
+				glGetQueryObjectiv(queries[query][1], GL_QUERY_RESULT_AVAILABLE, &available);
+				if(!available)
+				{
+					break;
+				}
+				GLuint64 start = 0;
+				GLuint64 finish = 0;
+				glGetQueryObjectui64v(queries[query][0], GL_QUERY_RESULT, &start);
+				glGetQueryObjectui64v(queries[query][1], GL_QUERY_RESULT, &finish);
+				pending[query] = false;
+
+				const float full = (finish - start) / 1000000.0f / (scales[query] * scales[query]);
+				fullMilliseconds = fullMilliseconds == 0.0f ? full : 0.8f * fullMilliseconds + 0.2f * full;
+			}
+			if(fullMilliseconds == 0.0f)
+			{
+				return;
+			}
+
+			const float wanted = std::min(std::max(std::sqrt(targetMilliseconds / fullMilliseconds), RESOLUTION_MIN_SCALE), 1.0f);
+			const float previous = scale;
+			scale = wanted < scale ? wanted : std::min(wanted, scale + RESOLUTION_SCALE_STEP);
+			if((previous == 1.0f) != (scale == 1.0f))
+			{
+				std::cout << (scale < 1.0f ? "Reducing the resolution, frames at " : "Back to full resolution, frames at ") << fullMilliseconds << " ms" << std::endl;
+			}
+		}
+};
+
+#endif
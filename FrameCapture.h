@@ -0,0 +1,557 @@
+#ifndef FRAMECAPTURE_H
+#define FRAMECAPTURE_H
+
+#include <glad/glad.h>
+
+#include "Benchmark.h"
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <cstdio>
+
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
+//Frames read back in flight. With none free, a frame of a sequence is dropped rather than waited for
+const int CAPTURE_READBACK_FRAMES = 4;
+
+enum CaptureFormat
+{
+	CAPTURE_PNG,
+	CAPTURE_PPM,
+	CAPTURE_Y4M
+};
+
+//Y4M file of a sequence, its frames written in order whatever the order the workers finish them in
+struct CaptureStream
+{
+	std::mutex mutex;
+	std::ofstream file;
+	int nextFrame;
+	std::map<int, std::vector<unsigned char> > finished;
+
+	CaptureStream(const std::string& path, const int width, const int height, const int framesPerSecond):nextFrame(0)
+	{
+		file.open(path.c_str(), std::ios::binary);
+		file << "YUV4MPEG2 W" << width << " H" << height << " F" << framesPerSecond << ":1 Ip A1:1 C420jpeg\n";
+	}
+
+	//Empty planes leave the frame out, for the frames after it not to wait for it
+	void write(const int frame, std::vector<unsigned char>& planes)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		finished[frame].swap(planes);
+		while(!finished.empty() && finished.begin()->first == nextFrame)
+		{
+			if(!finished.begin()->second.empty())
+			{
+				file << "FRAME\n";
+				file.write((const char*)&finished.begin()->second[0], finished.begin()->second.size());
+			}
+			finished.erase(finished.begin());
+			nextFrame++;
+		}
+	}
+};
+
+//Screenshots and frame sequences of the window, read back without stalling the frames. The frame drawn is read into a
+//pixel buffer with a fence after it, and mapped frames later once the fence has passed. Worker threads convert the mapped
+//pixels into a buffer of their own, after which the pixel buffer is unmapped by the render thread for the next frames,
+//then encode and write them: PNG files with PngWriter, binary PPM files, or a single Y4M stream for a video
+class FrameCapture
+{
+	public:
+	FrameCapture():format(CAPTURE_Y4M), framesPerSecond(60), created(false), screenshotRequested(false), sequence(false),
+	nextScreenshot(-1), nextSequence(-1), sequenceIndex(0), sequenceFrame(0), sequenceWidth(0), sequenceHeight(0), dropped(0), stopping(false), runningJobs(0)
+	{
+		for(int s=0; s<CAPTURE_READBACK_FRAMES; s++)
+		{
+			slots[s].state = SLOT_FREE;
+			slots[s].size = 0;
+		}
+	}
+
+	~FrameCapture()
+	{
+		stopWorkers();
+	}
+
+	//With the GL context current. The sequences are played at framesPerSecond
+	void create(const std::string& captureDirectory, const CaptureFormat sequenceFormat, const int sequenceFramesPerSecond)
+	{
+		directory = captureDirectory;
+		format = sequenceFormat;
+		framesPerSecond = sequenceFramesPerSecond;
+		for(int s=0; s<CAPTURE_READBACK_FRAMES; s++)
+		{
+			glGenBuffers(1, &slots[s].buffer);
+		}
+		created = true;
+	}
+
+	//Writes what is still in flight, then deletes the buffers, with the GL context still current
+	void release()
+	{
+		if(!created)
+		{
+			return;
+		}
+		stopSequence();
+		flush();
+		stopWorkers();
+		for(int s=0; s<CAPTURE_READBACK_FRAMES; s++)
+		{
+			glDeleteBuffers(1, &slots[s].buffer);
+		}
+		created = false;
+	}
+
+	//The next frame captured is saved as a PNG
+	void requestScreenshot()
+	{
+		screenshotRequested = true;
+	}
+
+	void startSequence()
+	{
+		sequence = true;
+		sequenceFrame = 0;
+		sequenceWidth = 0;
+		dropped = 0;
+		if(nextSequence == -1)
+		{
+			nextSequence = nextFreeIndex("sequence_", format == CAPTURE_Y4M ? ".y4m" : (format == CAPTURE_PNG ? "_00000.png" : "_00000.ppm"));
+		}
+		sequenceIndex = nextSequence++;
+		std::cout << "Capturing sequence " << sequenceIndex << std::endl;
+	}
+
+	//The frames in flight are still written
+	void stopSequence()
+	{
+		if(!sequence)
+		{
+			return;
+		}
+		sequence = false;
+		stream.reset();
+		std::cout << "Sequence " << sequenceIndex << " captured: " << sequenceFrame << " frames, " << dropped << " dropped" << std::endl;
+	}
+
+	bool isCapturingSequence()
+	{
+		return sequence;
+	}
+
+	//Starts reading the frame just drawn in the read framebuffer, if a screenshot or a sequence wants it. Call it after
+	//drawing, before the swap
+	void capture(const int width, const int height)
+	{
+		if(!created)
+		{
+			return;
+		}
+		if(screenshotRequested)
+		{
+			if(nextScreenshot == -1)
+			{
+				nextScreenshot = nextFreeIndex("screenshot_", ".png");
+			}
+			char name[32];
+			std::snprintf(name, sizeof(name), "screenshot_%03d.png", nextScreenshot);
+			Job job(CAPTURE_PNG, directory + "/" + name);
+			//left requested for the next frame while no buffer is free
+			screenshotRequested = !startRead(job, width, height);
+			if(!screenshotRequested)
+			{
+				std::cout << "Screenshot " << job.path << std::endl;
+				nextScreenshot++;
+			}
+		}
+		if(sequence)
+		{
+			if(sequenceWidth != 0 && (width != sequenceWidth || height != sequenceHeight))
+			{
+				std::cout << "The window was resized, stopping the capture" << std::endl;
+				stopSequence();
+				return;
+			}
+			sequenceWidth = width;
+			sequenceHeight = height;
+
+			char name[48];
+			std::snprintf(name, sizeof(name), format == CAPTURE_PNG ? "sequence_%03d_%05d.png" : "sequence_%03d_%05d.ppm", sequenceIndex, sequenceFrame);
+			Job job(format, directory + "/" + name);
+			job.frame = sequenceFrame;
+			if(format == CAPTURE_Y4M)
+			{
+				if(!stream)
+				{
+					std::snprintf(name, sizeof(name), "sequence_%03d.y4m", sequenceIndex);
+					stream = std::make_shared<CaptureStream>(directory + "/" + name, width, height, framesPerSecond);
+				}
+				job.stream = stream;
+			}
+			if(startRead(job, width, height))
+			{
+				sequenceFrame++;
+			}
+			else
+			{
+				dropped++;
+			}
+		}
+	}
+
+	//Hands the frames read back to the workers and frees the buffers they are done with, without waiting for either.
+	//Call it once per frame
+	void collect()
+	{
+		collect(false);
+	}
+
+	//Waits for every frame in flight to be written
+	void flush()
+	{
+		while(true)
+		{
+			collect(true);
+			bool idle = true;
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				for(int s=0; s<CAPTURE_READBACK_FRAMES; s++)
+				{
+					idle = idle && slots[s].state == SLOT_FREE;
+				}
+				idle = idle && jobs.empty() && runningJobs == 0;
+			}
+			if(idle)
+			{
+				return;
+			}
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+	}
+
+	private:
+		enum SlotState
+		{
+			SLOT_FREE,
+			//the GPU is copying the frame into the buffer
+			SLOT_READING,
+			//mapped, waiting for a worker or being converted by one
+			SLOT_MAPPED,
+			//converted, to be unmapped by the render thread
+			SLOT_CONVERTED
+		};
+
+		struct Job
+		{
+			CaptureFormat format;
+			std::string path;
+			int frame;
+			std::shared_ptr<CaptureStream> stream;
+			int slot;
+			const unsigned char* pixels;
+			int width;
+			int height;
+
+			Job(const CaptureFormat format, const std::string& path):format(format), path(path), frame(0), slot(-1), pixels(NULL), width(0), height(0)
+			{}
+		};
+
+		struct Slot
+		{
+			unsigned int buffer;
+			unsigned int size;
+			GLsync fence;
+			SlotState state;
+			Job* job;
+		};
+
+		std::string directory;
+		CaptureFormat format;
+		int framesPerSecond;
+		bool created;
+		bool screenshotRequested;
+		bool sequence;
+		//looked up once, the files in flight are not there yet
+		int nextScreenshot;
+		int nextSequence;
+		int sequenceIndex;
+		int sequenceFrame;
+		int sequenceWidth;
+		int sequenceHeight;
+		int dropped;
+		std::shared_ptr<CaptureStream> stream;
+
+		//slot states are shared with the workers, the buffers and fences only touched by the render thread
+		Slot slots[CAPTURE_READBACK_FRAMES];
+		std::vector<std::thread> workers;
+		std::mutex mutex;
+		std::condition_variable jobReady;
+		std::deque<Job*> jobs;
+		bool stopping;
+		int runningJobs;
+
+		bool startRead(const Job& job, const int width, const int height)
+		{
+			int s = 0;
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				while(s < CAPTURE_READBACK_FRAMES && slots[s].state != SLOT_FREE)
+				{
+					s++;
+				}
+			}
+			if(s == CAPTURE_READBACK_FRAMES)
+			{
+				return false;
+			}
+
+			//the workers are started by the first capture, a launch capturing nothing has none
+			if(workers.empty())
+			{
+				const unsigned int numberOfWorkers = std::max(1u, std::min(4u, std::thread::hardware_concurrency() / 2));
+				for(unsigned int w=0; w<numberOfWorkers; w++)
+				{
+					workers.push_back(std::thread(&FrameCapture::workLoop, this));
+				}
+			}
+
+			Slot& slot = slots[s];
+			const unsigned int size = width * height * 4;
+			glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+			if(slot.size != size)
+			{
+				glBufferData(GL_PIXEL_PACK_BUFFER, size, NULL, GL_STREAM_READ);
+				slot.size = size;
+			}
+			//RGBA rows are always aligned, and the format drivers copy without converting
+			glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, 0);
+			glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+			slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+			slot.job = new Job(job);
+			slot.job->slot = s;
+			slot.job->width = width;
+			slot.job->height = height;
+			std::lock_guard<std::mutex> lock(mutex);
+			slot.state = SLOT_READING;
+			return true;
+		}
+
+		void collect(const bool wait)
+		{
+			for(int s=0; s<CAPTURE_READBACK_FRAMES; s++)
+			{
+				Slot& slot = slots[s];
+				SlotState state;
+				{
+					std::lock_guard<std::mutex> lock(mutex);
+					state = slot.state;
+				}
+				if(state == SLOT_CONVERTED)
+				{
+					glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+					glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+					glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+					std::lock_guard<std::mutex> lock(mutex);
+					slot.state = SLOT_FREE;
+				}
+				else if(state == SLOT_READING)
+				{
+					GLenum status = glClientWaitSync(slot.fence, wait ? GL_SYNC_FLUSH_COMMANDS_BIT : 0, wait ? 1000000000ull : 0);
+					if(status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+					{
+						continue;
+					}
+					glDeleteSync(slot.fence);
+					glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+					slot.job->pixels = (const unsigned char*)glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, slot.size, GL_MAP_READ_BIT);
+					glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+					if(slot.job->pixels == NULL)
+					{
+						std::cout << "Failed to map a captured frame" << std::endl;
+						if(slot.job->stream)
+						{
+							std::vector<unsigned char> missing;
+							slot.job->stream->write(slot.job->frame, missing);
+						}
+						delete slot.job;
+						std::lock_guard<std::mutex> lock(mutex);
+						slot.state = SLOT_FREE;
+						continue;
+					}
+					std::lock_guard<std::mutex> lock(mutex);
+					slot.state = SLOT_MAPPED;
+					jobs.push_back(slot.job);
+					jobReady.notify_one();
+				}
+			}
+		}
+
+		void workLoop()
+		{
+			while(true)
+			{
+				Job* job = NULL;
+				{
+					std::unique_lock<std::mutex> lock(mutex);
+					jobReady.wait(lock, [this]{ return stopping || !jobs.empty(); });
+					if(jobs.empty())
+					{
+						return;
+					}
+					job = jobs.front();
+					jobs.pop_front();
+					runningJobs++;
+				}
+
+				std::vector<unsigned char> converted;
+				if(job->format == CAPTURE_Y4M)
+				{
+					toYuv420(job->pixels, job->width, job->height, converted);
+				}
+				else
+				{
+					toRgb(job->pixels, job->width, job->height, converted);
+				}
+				{
+					std::lock_guard<std::mutex> lock(mutex);
+					slots[job->slot].state = SLOT_CONVERTED;
+				}
+
+				if(job->format == CAPTURE_PNG)
+				{
+					PngWriter::write(job->path, converted, job->width, job->height);
+				}
+				else if(job->format == CAPTURE_PPM)
+				{
+					writePpm(job->path, converted, job->width, job->height);
+				}
+				else
+				{
+					job->stream->write(job->frame, converted);
+				}
+				delete job;
+				std::lock_guard<std::mutex> lock(mutex);
+				runningJobs--;
+			}
+		}
+
+		void stopWorkers()
+		{
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				stopping = true;
+			}
+			jobReady.notify_all();
+			for(unsigned int w=0; w<workers.size(); w++)
+			{
+				workers[w].join();
+			}
+			workers.clear();
+			stopping = false;
+		}
+
+		//First index whose file is not there yet, so that a launch does not overwrite the captures of the previous ones.
+		//Creates the directory if missing
+		int nextFreeIndex(const std::string& prefix, const std::string& suffix)
+		{
+#ifdef _WIN32
+			_mkdir(directory.c_str());
+#else
+			mkdir(directory.c_str(), 0755);
+#endif
+			for(int index=0; ; index++)
+			{
+				char number[16];
+				std::snprintf(number, sizeof(number), "%03d", index);
+				if(!std::ifstream((directory + "/" + prefix + number + suffix).c_str()))
+				{
+					return index;
+				}
+			}
+		}
+
+		//RGB rows from the top one, from the RGBA rows of GL from the bottom one
+		static void toRgb(const unsigned char* pixels, const int width, const int height, std::vector<unsigned char>& rgb)
+		{
+			rgb.resize(width * height * 3);
+			for(int row=0; row<height; row++)
+			{
+				const unsigned char* source = pixels + (height - 1 - row) * width * 4;
+				unsigned char* destination = &rgb[row * width * 3];
+				for(int x=0; x<width; x++)
+				{
+					destination[x * 3] = source[x * 4];
+					destination[x * 3 + 1] = source[x * 4 + 1];
+					destination[x * 3 + 2] = source[x * 4 + 2];
+				}
+			}
+		}
+
+		//Planes Y, U and V from the top row, BT.601 studio range, chroma averaged over 2x2 pixels
+		static void toYuv420(const unsigned char* pixels, const int width, const int height, std::vector<unsigned char>& planes)
+		{
+			const int chromaWidth = (width + 1) / 2;
+			const int chromaHeight = (height + 1) / 2;
+			planes.resize(width * height + 2 * chromaWidth * chromaHeight);
+			unsigned char* u = &planes[width * height];
+			unsigned char* v = u + chromaWidth * chromaHeight;
+			for(int row=0; row<height; row++)
+			{
+				const unsigned char* source = pixels + (height - 1 - row) * width * 4;
+				for(int x=0; x<width; x++)
+				{
+					planes[row * width + x] = ((66 * source[x * 4] + 129 * source[x * 4 + 1] + 25 * source[x * 4 + 2] + 128) >> 8) + 16;
+				}
+			}
+			for(int row=0; row<chromaHeight; row++)
+			{
+				for(int x=0; x<chromaWidth; x++)
+				{
+					int r = 0;
+					int g = 0;
+					int b = 0;
+					for(int k=0; k<4; k++)
+					{
+						const int sourceRow = std::min(2 * row + k / 2, height - 1);
+						const int sourceColumn = std::min(2 * x + k % 2, width - 1);
+						const unsigned char* pixel = pixels + ((height - 1 - sourceRow) * width + sourceColumn) * 4;
+						r += pixel[0];
+						g += pixel[1];
+						b += pixel[2];
+					}
+					u[row * chromaWidth + x] = ((-38 * r - 74 * g + 112 * b + 512) >> 10) + 128;
+					v[row * chromaWidth + x] = ((112 * r - 94 * g - 18 * b + 512) >> 10) + 128;
+				}
+			}
+		}
+
+		static bool writePpm(const std::string& path, const std::vector<unsigned char>& rgb, const int width, const int height)
+		{
+			std::ofstream file(path.c_str(), std::ios::binary);
+			file << "P6\n" << width << " " << height << "\n255\n";
+			file.write((const char*)&rgb[0], rgb.size());
+			if(!file)
+			{
+				std::cout << "Failed to write image at path: " << path << std::endl;
+				return false;
+			}
+			return true;
+		}
+};
+
+#endif
@@ -0,0 +1,196 @@
+#ifndef FRUSTUM_H
+#define FRUSTUM_H
+
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <cmath>
+#include <algorithm>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define FRUSTUM_USE_SSE
+#include <xmmintrin.h>
+#endif
+
+//Axis aligned boxes stored as structure of arrays, padded to a multiple of 4 so that they can be tested four at a time
+struct BoxList
+{
+	std::vector<float> centerX;
+	std::vector<float> centerY;
+	std::vector<float> centerZ;
+	std::vector<float> extentX;
+	std::vector<float> extentY;
+	std::vector<float> extentZ;
+	unsigned int count;
+
+	BoxList():count(0)
+	{}
+
+	void clear()
+	{
+		centerX.clear();
+		centerY.clear();
+		centerZ.clear();
+		extentX.clear();
+		extentY.clear();
+		extentZ.clear();
+		count = 0;
+	}
+
+	void addBox(const glm::vec3& minBound, const glm::vec3& maxBound)
+	{
+		//overwrite the padding left by the previous box, if any
+		resize(count);
+
+		glm::vec3 center = (minBound + maxBound) * 0.5f;
+		glm::vec3 extent = (maxBound - minBound) * 0.5f;
+		centerX.push_back(center.x);
+		centerY.push_back(center.y);
+		centerZ.push_back(center.z);
+		extentX.push_back(extent.x);
+		extentY.push_back(extent.y);
+		extentZ.push_back(extent.z);
+		count++;
+
+		//pad with empty boxes far away from everything, they are always culled
+		resize((count + 3) & ~3u);
+	}
+
+	private:
+		void resize(const unsigned int size)
+		{
+			const float farAway = -1e30f;
+			centerX.resize(size, farAway);
+			centerY.resize(size, farAway);
+			centerZ.resize(size, farAway);
+			extentX.resize(size, 0.0f);
+			extentY.resize(size, 0.0f);
+			extentZ.resize(size, 0.0f);
+		}
+};
+
+//Squared distance from a point to the nearest point of a box, 0 inside it: draws sorted by it go front to back
+inline float boxDistanceSquared(const glm::vec3& point, const glm::vec3& minBound, const glm::vec3& maxBound)
+{
+	float dx = std::max(std::max(minBound.x - point.x, point.x - maxBound.x), 0.0f);
+	float dy = std::max(std::max(minBound.y - point.y, point.y - maxBound.y), 0.0f);
+	float dz = std::max(std::max(minBound.z - point.z, point.z - maxBound.z), 0.0f);
+	return dx * dx + dy * dy + dz * dz;
+}
+
+class Frustum
+{
+	public:
+	Frustum()
+	{
+		for(int i=0; i<6; i++)
+		{
+			planes[i] = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+		}
+	}
+
+	//Extracts the six clipping planes from a projection * view * model matrix, so the planes are in the space of the model
+	void update(const glm::mat4& matrix)
+	{
+		glm::vec4 row0(matrix[0][0], matrix[1][0], matrix[2][0], matrix[3][0]);
+		glm::vec4 row1(matrix[0][1], matrix[1][1], matrix[2][1], matrix[3][1]);
+		glm::vec4 row2(matrix[0][2], matrix[1][2], matrix[2][2], matrix[3][2]);
+		glm::vec4 row3(matrix[0][3], matrix[1][3], matrix[2][3], matrix[3][3]);
+
+		planes[0] = row3 + row0; //left
+		planes[1] = row3 - row0; //right
+		planes[2] = row3 + row1; //bottom
+		planes[3] = row3 - row1; //top
+		planes[4] = row3 + row2; //near
+		planes[5] = row3 - row2; //far
+
+		for(int i=0; i<6; i++)
+		{
+			float length = std::sqrt(planes[i].x * planes[i].x + planes[i].y * planes[i].y + planes[i].z * planes[i].z);
+			if(length > 0.0f)
+			{
+				planes[i] = planes[i] / length;
+			}
+		}
+	}
+
+	bool isBoxVisible(const glm::vec3& minBound, const glm::vec3& maxBound) const
+	{
+		glm::vec3 center = (minBound + maxBound) * 0.5f;
+		glm::vec3 extent = (maxBound - minBound) * 0.5f;
+		for(int i=0; i<6; i++)
+		{
+			float distance = planes[i].x * center.x + planes[i].y * center.y + planes[i].z * center.z + planes[i].w;
+			float radius = std::fabs(planes[i].x) * extent.x + std::fabs(planes[i].y) * extent.y + std::fabs(planes[i].z) * extent.z;
+			if(distance + radius < 0.0f)
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	//Fills visible with the indices of the boxes that intersect the frustum
+	void cullBoxes(const BoxList& boxes, std::vector<unsigned int>& visible) const
+	{
+		visible.clear();
+
+#ifdef FRUSTUM_USE_SSE
+		const __m128 signMask = _mm_set1_ps(-0.0f);
+		__m128 planeX[6], planeY[6], planeZ[6], planeW[6];
+		__m128 absPlaneX[6], absPlaneY[6], absPlaneZ[6];
+		for(int p=0; p<6; p++)
+		{
+			planeX[p] = _mm_set1_ps(planes[p].x);
+			planeY[p] = _mm_set1_ps(planes[p].y);
+			planeZ[p] = _mm_set1_ps(planes[p].z);
+			planeW[p] = _mm_set1_ps(planes[p].w);
+			absPlaneX[p] = _mm_andnot_ps(signMask, planeX[p]);
+			absPlaneY[p] = _mm_andnot_ps(signMask, planeY[p]);
+			absPlaneZ[p] = _mm_andnot_ps(signMask, planeZ[p]);
+		}
+
+		const __m128 zero = _mm_setzero_ps();
+		for(unsigned int i=0; i<boxes.count; i+=4)
+		{
+			__m128 centerX = _mm_loadu_ps(&boxes.centerX[i]);
+			__m128 centerY = _mm_loadu_ps(&boxes.centerY[i]);
+			__m128 centerZ = _mm_loadu_ps(&boxes.centerZ[i]);
+			__m128 extentX = _mm_loadu_ps(&boxes.extentX[i]);
+			__m128 extentY = _mm_loadu_ps(&boxes.extentY[i]);
+			__m128 extentZ = _mm_loadu_ps(&boxes.extentZ[i]);
+
+			__m128 outside = zero;
+			for(int p=0; p<6; p++)
+			{
+				__m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(planeX[p], centerX), _mm_mul_ps(planeY[p], centerY)), _mm_add_ps(_mm_mul_ps(planeZ[p], centerZ), planeW[p]));
+				__m128 radius = _mm_add_ps(_mm_add_ps(_mm_mul_ps(absPlaneX[p], extentX), _mm_mul_ps(absPlaneY[p], extentY)), _mm_mul_ps(absPlaneZ[p], extentZ));
+				outside = _mm_or_ps(outside, _mm_cmplt_ps(_mm_add_ps(distance, radius), zero));
+			}
+
+			int outsideBits = _mm_movemask_ps(outside);
+			for(unsigned int k=0; k<4 && i + k < boxes.count; k++)
+			{
+				if(!(outsideBits & (1 << k)))
+				{
+					visible.push_back(i + k);
+				}
+			}
+		}
+#else
+		for(unsigned int i=0; i<boxes.count; i++)
+		{
+			glm::vec3 center(boxes.centerX[i], boxes.centerY[i], boxes.centerZ[i]);
+			glm::vec3 extent(boxes.extentX[i], boxes.extentY[i], boxes.extentZ[i]);
+			if(isBoxVisible(center - extent, center + extent))
+			{
+				visible.push_back(i);
+			}
+		}
+#endif
+	}
+
+	glm::vec4 planes[6];
+};
+
+#endif
@@ -0,0 +1,115 @@
+#ifndef HEADLESS_H
+#define HEADLESS_H
+
+#include <iostream>
+
+//EGL context without any window nor display, for running on machines without a screen. Mesa falls back to llvmpipe when
+//there is no GPU. Only built with HEADLESS_EGL defined, linking libEGL: without it create always fails
+#ifdef HEADLESS_EGL
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+
+class HeadlessContext
+{
+	public:
+	HeadlessContext()
+#ifdef HEADLESS_EGL
+	:display(EGL_NO_DISPLAY), context(EGL_NO_CONTEXT)
+#endif
+	{}
+
+	~HeadlessContext()
+	{
+		destroy();
+	}
+
+	//Makes current an OpenGL core context of the given version, with no default framebuffer: draw into a framebuffer object
+	bool create(const int major, const int minor)
+	{
+#ifdef HEADLESS_EGL
+		display = surfacelessDisplay();
+		EGLint versionMajor, versionMinor;
+		if(display == EGL_NO_DISPLAY || !eglInitialize(display, &versionMajor, &versionMinor))
+		{
+			std::cout << "Failed to initialize EGL" << std::endl;
+			return false;
+		}
+
+		const EGLint configAttributes[] = {EGL_SURFACE_TYPE, EGL_PBUFFER_BIT, EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT, EGL_NONE};
+		EGLConfig config;
+		EGLint numberOfConfigs = 0;
+		if(!eglChooseConfig(display, configAttributes, &config, 1, &numberOfConfigs) || numberOfConfigs == 0 || !eglBindAPI(EGL_OPENGL_API))
+		{
+			std::cout << "Failed to find an EGL config for OpenGL" << std::endl;
+			return false;
+		}
+
+		const EGLint contextAttributes[] = {EGL_CONTEXT_MAJOR_VERSION, major, EGL_CONTEXT_MINOR_VERSION, minor,
+			EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT, EGL_NONE};
+		context = eglCreateContext(display, config, EGL_NO_CONTEXT, contextAttributes);
+		if(context == EGL_NO_CONTEXT || !eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context))
+		{
+			std::cout << "Failed to create a headless OpenGL " << major << "." << minor << " context" << std::endl;
+			return false;
+		}
+		return true;
+#else
+		std::cout << "Headless mode needs a build with HEADLESS_EGL defined, linking EGL" << std::endl;
+		return false;
+#endif
+	}
+
+	//For gladLoadGLLoader
+	static void* getProcAddress(const char* name)
+	{
+#ifdef HEADLESS_EGL
+		return (void*)eglGetProcAddress(name);
+#else
+		return NULL;
+#endif
+	}
+
+	void destroy()
+	{
+#ifdef HEADLESS_EGL
+		if(display != EGL_NO_DISPLAY)
+		{
+			eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+			if(context != EGL_NO_CONTEXT)
+			{
+				eglDestroyContext(display, context);
+			}
+			eglTerminate(display);
+		}
+		display = EGL_NO_DISPLAY;
+		context = EGL_NO_CONTEXT;
+#endif
+	}
+
+	private:
+#ifdef HEADLESS_EGL
+		EGLDisplay display;
+		EGLContext context;
+
+		//The surfaceless platform when the driver has it, else the default display, which without a display server is
+		//surfaceless too on Mesa
+		static EGLDisplay surfacelessDisplay()
+		{
+#ifdef EGL_PLATFORM_SURFACELESS_MESA
+			PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay = (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+			if(getPlatformDisplay != NULL)
+			{
+				EGLDisplay display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+				if(display != EGL_NO_DISPLAY)
+				{
+					return display;
+				}
+			}
+#endif
+			return eglGetDisplay(EGL_DEFAULT_DISPLAY);
+		}
+#endif
+};
+
+#endif
@@ -0,0 +1,409 @@
+#ifndef HIZ_H
+#define HIZ_H
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+#include "shader.h"
+#include <iostream>
+#include <vector>
+#include <algorithm>
+
+//Depth pyramids read back in flight, the culling uses the latest one arrived
+const int HIZ_READBACK_FRAMES = 3;
+//Widest level of the pyramid read back to the CPU, the finer ones stay on the GPU
+const int HIZ_READBACK_WIDTH = 256;
+//Nearest draws of the terrain drawn as occluders
+const int HIZ_OCCLUDER_DRAWS = 64;
+//Widest footprint of a box tested, in texels per side of the pyramid level it is tested at
+const int HIZ_TEST_TEXELS = 8;
+
+//Hierarchical depth occlusion culling. The nearest chunks of a frame are drawn depth only, the depth is reduced on the GPU
+//to a pyramid keeping the farthest depth of every 2x2 texels, and a coarse level is read back through pixel buffers without
+//waiting, to be reduced further on the CPU. The boxes of the next frames are projected with the matrix of that frame: a
+//box whose nearest depth is behind the farthest depth over its footprint was hidden. The data being some frames old, a
+//chunk uncovered by the camera shows up that many frames late
+class HiZCuller
+{
+	public:
+	HiZCuller():width(0), height(0), depthTexture(0), pyramid(0), depthFramebuffer(0), pyramidFramebuffer(0), emptyArray(0),
+	readLevel(0), next(0), source(NULL), drawnSource(NULL), tested(0), culled(0), frames(0)
+	{
+		std::fill(pending, pending + HIZ_READBACK_FRAMES, false);
+		std::fill(fences, fences + HIZ_READBACK_FRAMES, (GLsync)0);
+	}
+
+	//With the GL context current, for the size of the frames
+	bool create(const int frameWidth, const int frameHeight)
+	{
+		glGenTextures(1, &depthTexture);
+		glGenTextures(1, &pyramid);
+		glGenFramebuffers(1, &depthFramebuffer);
+		glGenFramebuffers(1, &pyramidFramebuffer);
+		glGenBuffers(HIZ_READBACK_FRAMES, pixelBuffers);
+		glGenVertexArrays(1, &emptyArray);
+		return resize(frameWidth, frameHeight);
+	}
+
+	//Drops the pyramids in flight, their size is no longer the one of the frames
+	bool resize(const int frameWidth, const int frameHeight)
+	{
+		width = frameWidth;
+		height = frameHeight;
+		dropPending();
+		source = NULL;
+
+		glBindTexture(GL_TEXTURE_2D, depthTexture);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT32F, width, height, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
+		setNearest();
+		glBindFramebuffer(GL_FRAMEBUFFER, depthFramebuffer);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depthTexture, 0);
+		glDrawBuffer(GL_NONE);
+		glReadBuffer(GL_NONE);
+		bool complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+
+		//halved down to the first level narrow enough to be read back
+		levelWidths.clear();
+		levelHeights.clear();
+		int levelWidth = width;
+		int levelHeight = height;
+		do
+		{
+			levelWidth = std::max(levelWidth / 2, 1);
+			levelHeight = std::max(levelHeight / 2, 1);
+			levelWidths.push_back(levelWidth);
+			levelHeights.push_back(levelHeight);
+		}
+		while(levelWidth > HIZ_READBACK_WIDTH);
+		readLevel = levelWidths.size() - 1;
+
+		glBindTexture(GL_TEXTURE_2D, pyramid);
+		for(unsigned int l=0; l<levelWidths.size(); l++)
+		{
+			glTexImage2D(GL_TEXTURE_2D, l, GL_R32F, levelWidths[l], levelHeights[l], 0, GL_RED, GL_FLOAT, NULL);
+		}
+		setNearest();
+		glBindTexture(GL_TEXTURE_2D, 0);
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+		for(int b=0; b<HIZ_READBACK_FRAMES; b++)
+		{
+			glBindBuffer(GL_PIXEL_PACK_BUFFER, pixelBuffers[b]);
+			glBufferData(GL_PIXEL_PACK_BUFFER, levelWidths[readLevel] * levelHeights[readLevel] * sizeof(float), NULL, GL_STREAM_READ);
+		}
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+		if(!complete)
+		{
+			std::cout << "Occlusion depth framebuffer incomplete" << std::endl;
+		}
+		return complete;
+	}
+
+	//Deletes the textures, framebuffers and buffers, with the GL context still current
+	void release()
+	{
+		if(depthFramebuffer == 0)
+		{
+			return;
+		}
+		dropPending();
+		glDeleteTextures(1, &depthTexture);
+		glDeleteTextures(1, &pyramid);
+		glDeleteFramebuffers(1, &depthFramebuffer);
+		glDeleteFramebuffers(1, &pyramidFramebuffer);
+		glDeleteBuffers(HIZ_READBACK_FRAMES, pixelBuffers);
+		glDeleteVertexArrays(1, &emptyArray);
+		depthFramebuffer = 0;
+	}
+
+	//Takes the newest pyramid whose readback has finished, if any. Call it once per frame before testing boxes
+	void collect()
+	{
+		int arrived = -1;
+		for(int p=0; p<HIZ_READBACK_FRAMES; p++)
+		{
+			const int slot = (next + p) % HIZ_READBACK_FRAMES;
+			if(!pending[slot])
+			{
+				continue;
+			}
+			GLenum status = glClientWaitSync(fences[slot], 0, 0);
+			if(status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+			{
+				break;
+			}
+			glDeleteSync(fences[slot]);
+			pending[slot] = false;
+			arrived = slot;
+		}
+		if(arrived == -1)
+		{
+			return;
+		}
+
+		const int baseWidth = levelWidths[readLevel];
+		const int baseHeight = levelHeights[readLevel];
+		levels.resize(1);
+		levels[0].resize(baseWidth * baseHeight);
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, pixelBuffers[arrived]);
+		const float* depths = (const float*)glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, levels[0].size() * sizeof(float), GL_MAP_READ_BIT);
+		if(depths == NULL)
+		{
+			glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+			return;
+		}
+		std::copy(depths, depths + levels[0].size(), levels[0].begin());
+		glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+		matrix = slotMatrices[arrived];
+		source = slotSources[arrived];
+
+		cpuWidths.assign(1, baseWidth);
+		cpuHeights.assign(1, baseHeight);
+		while(cpuWidths.back() > 1 || cpuHeights.back() > 1)
+		{
+			reduceLevel();
+		}
+	}
+
+	//The culler for the boxes of the given surface if a pyramid drawn from it has arrived, else NULL: the boxes of another
+	//surface cannot be tested against it. Counts a frame culled
+	HiZCuller* forSurface(const void* surface)
+	{
+		if(surface == NULL || source != surface)
+		{
+			return NULL;
+		}
+		frames++;
+		return this;
+	}
+
+	//Whether a box, in the space of the matrix given to beginOccluders, was hidden in the frame of the pyramid
+	bool isOccluded(const glm::vec3& minBound, const glm::vec3& maxBound)
+	{
+		tested++;
+		//footprint in normalized device coordinates, clamped to the frame
+		glm::vec2 low(1.0f);
+		glm::vec2 high(-1.0f);
+		float nearest = 1.0f;
+		for(int c=0; c<8; c++)
+		{
+			glm::vec4 corner((c & 1) ? maxBound.x : minBound.x, (c & 2) ? maxBound.y : minBound.y, (c & 4) ? maxBound.z : minBound.z, 1.0f);
+			glm::vec4 clip = matrix * corner;
+			//crossing the plane of the camera: the projection of the box is unbounded
+			if(clip.w <= 0.0001f)
+			{
+				return false;
+			}
+			const float x = clip.x / clip.w;
+			const float y = clip.y / clip.w;
+			low = glm::vec2(std::min(low.x, x), std::min(low.y, y));
+			high = glm::vec2(std::max(high.x, x), std::max(high.y, y));
+			nearest = std::min(nearest, clip.z / clip.w * 0.5f + 0.5f);
+		}
+		if(nearest <= 0.0f)
+		{
+			return false;
+		}
+
+		//footprint in texels of the level read back, from the pixels of the frame
+		const int shift = readLevel + 1;
+		const int x0 = texel(low.x, width, shift, cpuWidths[0]);
+		const int x1 = texel(high.x, width, shift, cpuWidths[0]);
+		const int y0 = texel(low.y, height, shift, cpuHeights[0]);
+		const int y1 = texel(high.y, height, shift, cpuHeights[0]);
+
+		//the finest level where it spans at most HIZ_TEST_TEXELS texels per side: with 2x2 at most, the texels read could
+		//reach twice as far as the footprint and fail to occlude it
+		unsigned int level = 0;
+		while(level + 1 < levels.size() && ((x1 >> level) - (x0 >> level) >= HIZ_TEST_TEXELS || (y1 >> level) - (y0 >> level) >= HIZ_TEST_TEXELS))
+		{
+			level++;
+		}
+		const int levelWidth = cpuWidths[level];
+		const int levelHeight = cpuHeights[level];
+		float farthest = 0.0f;
+		for(int y=std::min(y0 >> level, levelHeight - 1); y<=std::min(y1 >> level, levelHeight - 1); y++)
+		{
+			for(int x=std::min(x0 >> level, levelWidth - 1); x<=std::min(x1 >> level, levelWidth - 1); x++)
+			{
+				farthest = std::max(farthest, levels[level][y * levelWidth + x]);
+			}
+		}
+		if(nearest > farthest)
+		{
+			culled++;
+			return true;
+		}
+		return false;
+	}
+
+	//Binds the depth framebuffer for drawing the occluders of surface with the matrix from its space to clip space, in
+	//the program in use. Polygons are filled whatever the mode
+	void beginOccluders(const void* surface, const glm::mat4& surfaceToClip)
+	{
+		drawnSource = surface;
+		drawnMatrix = surfaceToClip;
+		glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &savedFramebuffer);
+		glGetIntegerv(GL_VIEWPORT, savedViewport);
+		glGetIntegerv(GL_POLYGON_MODE, savedPolygonMode);
+		glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+		glBindFramebuffer(GL_FRAMEBUFFER, depthFramebuffer);
+		glViewport(0, 0, width, height);
+		glClear(GL_DEPTH_BUFFER_BIT);
+	}
+
+	//Reduces the depth of the occluders to the pyramid with the reduction program, starts reading its coarse level back,
+	//and restores the framebuffer and the viewport. The reduction leaves texture unit 0 with no texture
+	void endOccluders(Shader& reduction)
+	{
+		reduction.use();
+		glBindVertexArray(emptyArray);
+		glActiveTexture(GL_TEXTURE0);
+		glBindFramebuffer(GL_FRAMEBUFFER, pyramidFramebuffer);
+		for(unsigned int l=0; l<levelWidths.size(); l++)
+		{
+			//the level read is the only one the sampler sees, never the one drawn into
+			glBindTexture(GL_TEXTURE_2D, l == 0 ? depthTexture : pyramid);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, l == 0 ? 0 : l - 1);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, l == 0 ? 0 : l - 1);
+			glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, pyramid, l);
+			glViewport(0, 0, levelWidths[l], levelHeights[l]);
+			glDrawArrays(GL_TRIANGLES, 0, 3);
+		}
+		glBindTexture(GL_TEXTURE_2D, 0);
+
+		//a pyramid whose buffer is still in flight is dropped, the culling goes on with the older ones
+		if(!pending[next])
+		{
+			glReadBuffer(GL_COLOR_ATTACHMENT0);
+			glBindBuffer(GL_PIXEL_PACK_BUFFER, pixelBuffers[next]);
+			glReadPixels(0, 0, levelWidths[readLevel], levelHeights[readLevel], GL_RED, GL_FLOAT, 0);
+			glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+			fences[next] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+			pending[next] = true;
+			slotMatrices[next] = drawnMatrix;
+			slotSources[next] = drawnSource;
+			next = (next + 1) % HIZ_READBACK_FRAMES;
+		}
+
+		glBindFramebuffer(GL_FRAMEBUFFER, savedFramebuffer);
+		glViewport(savedViewport[0], savedViewport[1], savedViewport[2], savedViewport[3]);
+		glPolygonMode(GL_FRONT_AND_BACK, savedPolygonMode[0]);
+	}
+
+	//Boxes tested and culled per frame since the last reset
+	double getTestedPerFrame()
+	{
+		return frames > 0 ? (double)tested / frames : 0.0;
+	}
+
+	double getCulledPerFrame()
+	{
+		return frames > 0 ? (double)culled / frames : 0.0;
+	}
+
+	int getFrames()
+	{
+		return frames;
+	}
+
+	void reset()
+	{
+		tested = 0;
+		culled = 0;
+		frames = 0;
+	}
+
+	private:
+		//size of the frames and of the depth drawn
+		int width;
+		int height;
+		unsigned int depthTexture;
+		//levels from half the size of the frames to the one read back
+		unsigned int pyramid;
+		unsigned int depthFramebuffer;
+		unsigned int pyramidFramebuffer;
+		unsigned int emptyArray;
+		std::vector<int> levelWidths;
+		std::vector<int> levelHeights;
+		int readLevel;
+
+		unsigned int pixelBuffers[HIZ_READBACK_FRAMES];
+		GLsync fences[HIZ_READBACK_FRAMES];
+		bool pending[HIZ_READBACK_FRAMES];
+		glm::mat4 slotMatrices[HIZ_READBACK_FRAMES];
+		const void* slotSources[HIZ_READBACK_FRAMES];
+		int next;
+
+		//the pyramid tested against, from the level read back to 1x1, and the frame it was drawn in
+		std::vector<std::vector<float> > levels;
+		std::vector<int> cpuWidths;
+		std::vector<int> cpuHeights;
+		glm::mat4 matrix;
+		const void* source;
+
+		//the frame whose occluders are being drawn
+		glm::mat4 drawnMatrix;
+		const void* drawnSource;
+		GLint savedFramebuffer;
+		GLint savedViewport[4];
+		GLint savedPolygonMode[2];
+
+		unsigned long long tested;
+		unsigned long long culled;
+		int frames;
+
+		static void setNearest()
+		{
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		}
+
+		//Texel of the level read back under a normalized device coordinate. The levels are halved rounding down, their last
+		//texels covering the odd row or column left: the pixel shifted is clamped to it
+		static int texel(const float ndc, const int pixels, const int shift, const int texels)
+		{
+			const float clamped = std::min(std::max(ndc, -1.0f), 1.0f);
+			const int pixel = std::min((int)((clamped * 0.5f + 0.5f) * pixels), pixels - 1);
+			return std::min(pixel >> shift, texels - 1);
+		}
+
+		//Appends the next level of the CPU pyramid, as hiz.fs does on the GPU
+		void reduceLevel()
+		{
+			const int sourceWidth = cpuWidths.back();
+			const int sourceHeight = cpuHeights.back();
+			const int levelWidth = std::max(sourceWidth / 2, 1);
+			const int levelHeight = std::max(sourceHeight / 2, 1);
+			std::vector<float> level(levelWidth * levelHeight, 0.0f);
+			for(int y=0; y<sourceHeight; y++)
+			{
+				for(int x=0; x<sourceWidth; x++)
+				{
+					float& farthest = level[std::min(y / 2, levelHeight - 1) * levelWidth + std::min(x / 2, levelWidth - 1)];
+					farthest = std::max(farthest, levels.back()[y * sourceWidth + x]);
+				}
+			}
+			levels.push_back(level);
+			cpuWidths.push_back(levelWidth);
+			cpuHeights.push_back(levelHeight);
+		}
+
+		void dropPending()
+		{
+			for(int p=0; p<HIZ_READBACK_FRAMES; p++)
+			{
+				if(pending[p])
+				{
+					glDeleteSync(fences[p]);
+				}
+				pending[p] = false;
+			}
+		}
+};
+
+#endif
@@ -0,0 +1,328 @@
+#ifndef LAVAOVERLAY_H
+#define LAVAOVERLAY_H
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+#include "Matrix.h"
+#include "Surface.h"
+#include <iostream>
+#include <vector>
+#include <cstring>
+
+//Mesh of the lava alone, laid over a terrain built without it: only the cells with lava get vertices, and the cells
+//with lava are tracked as the lava changes, so updating and uploading the mesh costs in proportion to the flow and the
+//terrain buffers never change. Every vertex holds position, normal and temperature, normalized by the shader over
+//getTemperatureRange
+class LavaOverlay
+{
+	public:
+	LavaOverlay():offset(0.0f), numberOfAttributes(3), rows(0), columns(0), frame(-1), minTemperature(0.0f), maxTemperature(1.0f), VAO(0), VBO(0), EBO(0), uploadedIndices(0)
+	{}
+
+	//Builds the mesh over the cells of lava thicker than 0 that are not holes of the terrain
+	void build(Surface& terrain, Matrix& lava, Matrix& temperature)
+	{
+		values.clear();
+		resize(terrain);
+		if(!lava.isLoaded() || !temperature.isLoaded() || lava.getRows() != rows || lava.getColumns() != columns
+			|| temperature.getRows() != rows || temperature.getColumns() != columns)
+		{
+			std::cout << "Lava overlay does not match the " << rows << "x" << columns << " terrain" << std::endl;
+			buildMesh(terrain);
+			return;
+		}
+		minTemperature = temperature.getMinValue();
+		maxTemperature = temperature.getMaxValue();
+		frame = -1;
+
+		for(int i=0; i<rows; i++)
+		{
+			for(int j=0; j<columns; j++)
+			{
+				values[(i * columns + j) * 2] = lava.getValue(i, j);
+				values[(i * columns + j) * 2 + 1] = temperature.getValue(i, j);
+				updateCell(terrain, i * columns + j);
+			}
+		}
+		buildMesh(terrain);
+	}
+
+	//Moves the mesh to a frame of the lava playback, thickness and temperature normalized to [0, 1] interleaved per cell.
+	//The rows are compared whole and only the cells that changed are added to or removed from the flow
+	void update(Surface& terrain, const std::vector<float>& cells, const int newFrame)
+	{
+		resize(terrain);
+		const size_t rowFloats = (size_t)columns * 2;
+		if(cells.size() != rows * rowFloats)
+		{
+			std::cout << "Lava overlay frame " << newFrame << " does not match the " << rows << "x" << columns << " terrain" << std::endl;
+			return;
+		}
+		minTemperature = 0.0f;
+		maxTemperature = 1.0f;
+		frame = newFrame;
+
+		for(int i=0; i<rows; i++)
+		{
+			if(std::memcmp(&values[i * rowFloats], &cells[i * rowFloats], rowFloats * sizeof(float)) == 0)
+			{
+				continue;
+			}
+			for(size_t k=i * rowFloats; k<(i + 1) * rowFloats; k+=2)
+			{
+				if(values[k] != cells[k] || values[k + 1] != cells[k + 1])
+				{
+					values[k] = cells[k];
+					values[k + 1] = cells[k + 1];
+					updateCell(terrain, k / 2);
+				}
+			}
+		}
+		buildMesh(terrain);
+	}
+
+	//Frame of the playback the mesh shows, -1 if built from a single grid or never
+	int getFrame()
+	{
+		return frame;
+	}
+
+	//Sends the mesh to the GPU, replacing the previous one. Call it with the GL context current
+	void upload()
+	{
+		if(VAO == 0)
+		{
+			glGenVertexArrays(1, &VAO);
+			glGenBuffers(1, &VBO);
+			glGenBuffers(1, &EBO);
+			glBindVertexArray(VAO);
+			glBindBuffer(GL_ARRAY_BUFFER, VBO);
+			glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+
+			//Position attribute
+			glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 9 * sizeof(GLfloat), (GLvoid*)0);
+			glEnableVertexAttribArray(0);
+
+			//Normal attribute
+			glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 9 * sizeof(GLfloat), (GLvoid*) ( 3 * sizeof(GLfloat) ));
+			glEnableVertexAttribArray(1);
+
+			//Temperature
+			glVertexAttribPointer(2, 1, GL_FLOAT, GL_FALSE, 9 * sizeof(GLfloat), (GLvoid*) ( 6 * sizeof(GLfloat) ));
+			glEnableVertexAttribArray(2);
+		}
+
+		glBindVertexArray(VAO);
+		glBindBuffer(GL_ARRAY_BUFFER, VBO);
+		glBufferData(GL_ARRAY_BUFFER, sizeof(glm::vec3) * vertices.size(), vertices.empty() ? NULL : &vertices[0], GL_DYNAMIC_DRAW);
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(unsigned int) * indices.size(), indices.empty() ? NULL : &indices[0], GL_DYNAMIC_DRAW);
+		uploadedIndices = indices.size();
+	}
+
+	void draw()
+	{
+		if(VAO == 0 || uploadedIndices == 0)
+		{
+			return;
+		}
+		//pulled towards the camera in depth rather than lifted in height, so that it wins over the terrain at any distance
+		//where the lava is thin
+		glEnable(GL_POLYGON_OFFSET_FILL);
+		glEnable(GL_POLYGON_OFFSET_LINE);
+		glPolygonOffset(-1.0f, -2.0f);
+		glBindVertexArray(VAO);
+		glDrawElements(GL_TRIANGLES, uploadedIndices, GL_UNSIGNED_INT, 0);
+		glDisable(GL_POLYGON_OFFSET_FILL);
+		glDisable(GL_POLYGON_OFFSET_LINE);
+	}
+
+	unsigned int getNumberOfCells()
+	{
+		return indices.size() / 6;
+	}
+
+	glm::vec2 getTemperatureRange()
+	{
+		return glm::vec2(minTemperature, maxTemperature);
+	}
+
+	//Height in metres the terrain can be above the ground of the grid where simplified, added to the overlay to stay on top
+	float offset;
+	std::vector<glm::vec3> vertices;
+	std::vector<unsigned int> indices;
+
+	private:
+		unsigned int numberOfAttributes;
+		int rows;
+		int columns;
+		int frame;
+		float minTemperature;
+		float maxTemperature;
+		//thickness and temperature of every cell, interleaved
+		std::vector<float> values;
+		//the cells with lava, and the position of every cell among them, -1 if without lava
+		std::vector<int> cells;
+		std::vector<int> cellPositions;
+		//vertex of every corner during a build, -1 outside it
+		std::vector<int> cornerVertices;
+		unsigned int VAO;
+		unsigned int VBO;
+		unsigned int EBO;
+		unsigned int uploadedIndices;
+
+		//Empties the flow when the terrain is not the one of the previous build
+		void resize(Surface& terrain)
+		{
+			if(rows == terrain.getRows() && columns == terrain.getColumns() && !values.empty())
+			{
+				return;
+			}
+			rows = terrain.getRows();
+			columns = terrain.getColumns();
+			values.assign(rows * columns * 2, 0.0f);
+			cells.clear();
+			cellPositions.assign(rows * columns, -1);
+			cornerVertices.assign((rows + 1) * (columns + 1), -1);
+		}
+
+		//Adds the cell to the flow or removes it, after its values changed
+		void updateCell(Surface& terrain, const int cell)
+		{
+			const bool withLava = values[cell * 2] > 0.0f && !terrain.isHoleCell(cell / columns, cell % columns);
+			if(withLava && cellPositions[cell] == -1)
+			{
+				cellPositions[cell] = cells.size();
+				cells.push_back(cell);
+			}
+			else if(!withLava && cellPositions[cell] != -1)
+			{
+				//the last cell takes its place
+				const int position = cellPositions[cell];
+				cells[position] = cells.back();
+				cellPositions[cells[position]] = position;
+				cells.pop_back();
+				cellPositions[cell] = -1;
+			}
+		}
+
+		void buildMesh(Surface& terrain)
+		{
+			vertices.clear();
+			indices.clear();
+
+			//one vertex per corner of the cells with lava
+			std::vector<int> corners;
+			for(unsigned int c=0; c<cells.size(); c++)
+			{
+				const int i = cells[c] / columns;
+				const int j = cells[c] % columns;
+				for(int k=0; k<4; k++)
+				{
+					const int corner = (i + (k & 1)) * (columns + 1) + j + (k >> 1);
+					if(cornerVertices[corner] == -1)
+					{
+						cornerVertices[corner] = corners.size();
+						corners.push_back(corner);
+					}
+				}
+			}
+
+			vertices.resize(corners.size() * numberOfAttributes);
+			for(unsigned int v=0; v<corners.size(); v++)
+			{
+				const int row = corners[v] / (columns + 1);
+				const int column = corners[v] % (columns + 1);
+				vertices[v * numberOfAttributes] = glm::vec3(column * terrain.getCellSize(), terrainHeight(terrain, row, column) + offset, row * terrain.getCellSize());
+
+				//the corner takes the mean thickness of the cells around it, so the flow sinks into the terrain at its border,
+				//and the mean temperature of the ones with lava
+				float thickness = 0.0f;
+				float cellTemperature = 0.0f;
+				int terrainCells = 0;
+				int lavaCells = 0;
+				for(int i=row - 1; i<=row; i++)
+				{
+					for(int j=column - 1; j<=column; j++)
+					{
+						if(i < 0 || j < 0 || i >= rows || j >= columns || terrain.isHoleCell(i, j))
+						{
+							continue;
+						}
+						terrainCells++;
+						if(cellPositions[i * columns + j] != -1)
+						{
+							thickness += values[(i * columns + j) * 2];
+							cellTemperature += values[(i * columns + j) * 2 + 1];
+							lavaCells++;
+						}
+					}
+				}
+				vertices[v * numberOfAttributes].y += thickness / terrainCells;
+				vertices[v * numberOfAttributes + 2] = glm::vec3(cellTemperature / lavaCells, 0.0f, 0.0f);
+			}
+
+			//normals from the heights of the neighbouring corners, on the overlay or else on the terrain
+			for(unsigned int v=0; v<corners.size(); v++)
+			{
+				const int row = corners[v] / (columns + 1);
+				const int column = corners[v] % (columns + 1);
+				float left = height(terrain, row, column - 1, v);
+				float right = height(terrain, row, column + 1, v);
+				float up = height(terrain, row - 1, column, v);
+				float down = height(terrain, row + 1, column, v);
+				vertices[v * numberOfAttributes + 1] = glm::normalize(glm::vec3(left - right, 2.0f * terrain.getCellSize(), up - down));
+			}
+
+			for(unsigned int c=0; c<cells.size(); c++)
+			{
+				const int corner = (cells[c] / columns) * (columns + 1) + cells[c] % columns;
+				const int topLeftIndex = cornerVertices[corner];
+				const int bottomLeftIndex = cornerVertices[corner + columns + 1];
+				const int topRightIndex = cornerVertices[corner + 1];
+				const int bottomRightIndex = cornerVertices[corner + columns + 2];
+
+				indices.push_back(topLeftIndex);
+				indices.push_back(bottomLeftIndex);
+				indices.push_back(topRightIndex);
+
+				indices.push_back(bottomLeftIndex);
+				indices.push_back(topRightIndex);
+				indices.push_back(bottomRightIndex);
+			}
+
+			//leave the corner table empty for the next build, touching only the corners used
+			for(unsigned int v=0; v<corners.size(); v++)
+			{
+				cornerVertices[corners[v]] = -1;
+			}
+		}
+
+		float terrainHeight(Surface& terrain, const int row, const int column)
+		{
+			return terrain.vertices[terrain.getCornerIndex(row, column) * terrain.getNumberOfAttributes()].y;
+		}
+
+		//Height of the overlay at a corner, or of the terrain under it if the corner is not part of the overlay,
+		//or of the vertex v if the corner is outside the terrain
+		float height(Surface& terrain, const int row, const int column, const unsigned int v)
+		{
+			if(row < 0 || column < 0 || row > rows || column > columns)
+			{
+				return vertices[v * numberOfAttributes].y;
+			}
+			const int corner = row * (columns + 1) + column;
+			if(cornerVertices[corner] != -1)
+			{
+				return vertices[cornerVertices[corner] * numberOfAttributes].y;
+			}
+			if(terrain.getCornerIndex(row, column) == -1)
+			{
+				return vertices[v * numberOfAttributes].y;
+			}
+			return terrainHeight(terrain, row, column) + offset;
+		}
+};
+
+#endif
@@ -0,0 +1,570 @@
+#ifndef LAVAPLAYBACK_H
+#define LAVAPLAYBACK_H
+
+#include <glad/glad.h>
+
+#include "Matrix.h"
+#include "LavaSeries.h"
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <cmath>
+#include <limits>
+
+//Number of textures and pixel buffers the frames go through: the two keyframes being blended and the one being uploaded
+const int PLAYBACK_BUFFERS = 3;
+
+//Plays a sequence of lava thickness and temperature grids over a static terrain. A background thread decodes the frames
+//around the playhead, the render thread copies them into a pixel buffer and from there into an RG32F texture holding
+//thickness and normalized temperature. The shader blends the keyframes on both sides of the playhead, so between two
+//keyframes nothing is uploaded and only one new frame is uploaded when the playhead crosses one.
+//Temperatures are normalized over the range of the whole sequence, so that the same temperature has the same colour in
+//every frame and blending two normalized keyframes blends their temperatures
+class LavaPlayback
+{
+	public:
+	LavaPlayback(const int prefetchFrames = 8):
+	playing(true), framesPerSecond(10.0f), deterministic(false), prefetchFrames(std::max(2, prefetchFrames)), numberOfFrames(0),
+	rows(0), columns(0), minTemperature(0.0f), maxTemperature(0.0f), position(0.0f), blend(0.0f), currentSlot(0), nextSlot(1),
+	playhead(0), stopping(false)
+	{
+		for(int k=0; k<PLAYBACK_BUFFERS; k++)
+		{
+			textures[k] = 0;
+			pixelBuffers[k] = 0;
+			slotFrames[k] = -1;
+		}
+		drawnSlots[0] = currentSlot;
+		drawnSlots[1] = nextSlot;
+	}
+
+	~LavaPlayback()
+	{
+		stopDecoder();
+	}
+
+	//Looks for the frames of the sequence. The sources are either printf formats with the frame number, e.g.
+	//"./data/frames/lava_%04d.dat", or series written by LavaSeriesWriter, ending in ".lvs"
+	void open(const std::string& lavaSource, const std::string& temperatureSource)
+	{
+		if(decoder.joinable())
+		{
+			return;
+		}
+		lavaPattern = lavaSource;
+		temperaturePattern = temperatureSource;
+		numberOfFrames = 0;
+		lavaSeries.reset();
+		temperatureSeries.reset();
+		if(isSeries(lavaPattern) && isSeries(temperaturePattern))
+		{
+			lavaSeries.reset(new LavaSeriesReader(lavaPattern));
+			temperatureSeries.reset(new LavaSeriesReader(temperaturePattern));
+			if(lavaSeries->isValid() && temperatureSeries->isValid())
+			{
+				numberOfFrames = std::min(lavaSeries->getNumberOfFrames(), temperatureSeries->getNumberOfFrames());
+			}
+		}
+		else
+		{
+			while(fileExists(framePath(lavaPattern, numberOfFrames)) && fileExists(framePath(temperaturePattern, numberOfFrames)))
+			{
+				numberOfFrames++;
+			}
+		}
+	}
+
+	//Stops decoding and deletes the textures and pixel buffers, with the GL context still current
+	void release()
+	{
+		stopDecoder();
+		if(textures[0] != 0)
+		{
+			glDeleteTextures(PLAYBACK_BUFFERS, textures);
+			glDeleteBuffers(PLAYBACK_BUFFERS, pixelBuffers);
+		}
+		for(int k=0; k<PLAYBACK_BUFFERS; k++)
+		{
+			textures[k] = 0;
+			pixelBuffers[k] = 0;
+			slotFrames[k] = -1;
+			slotCells[k].clear();
+		}
+		decoded.clear();
+	}
+
+	int getNumberOfFrames()
+	{
+		return numberOfFrames;
+	}
+
+	//Creates the textures for a grid of rows x columns cells and starts decoding. Call it with the GL context current
+	void start(const int gridRows, const int gridColumns)
+	{
+		if(numberOfFrames == 0 || decoder.joinable())
+		{
+			return;
+		}
+		rows = gridRows;
+		columns = gridColumns;
+
+		glGenTextures(PLAYBACK_BUFFERS, textures);
+		glGenBuffers(PLAYBACK_BUFFERS, pixelBuffers);
+		for(int k=0; k<PLAYBACK_BUFFERS; k++)
+		{
+			glBindTexture(GL_TEXTURE_2D, textures[k]);
+			glTexImage2D(GL_TEXTURE_2D, 0, GL_RG32F, columns, rows, 0, GL_RG, GL_FLOAT, NULL);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pixelBuffers[k]);
+			glBufferData(GL_PIXEL_UNPACK_BUFFER, frameBytes(), NULL, GL_STREAM_DRAW);
+		}
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+		decoder = std::thread(&LavaPlayback::decodeLoop, this);
+	}
+
+	//Moves the playhead and uploads the keyframes around it as soon as they have been decoded, waiting for them only when
+	//deterministic
+	void update(const float deltaTime)
+	{
+		if(numberOfFrames == 0)
+		{
+			return;
+		}
+
+		if(playing)
+		{
+			position = std::fmod(position + deltaTime * framesPerSecond, (float)numberOfFrames);
+		}
+
+		int key = (int)position;
+		int nextKey = (key + 1) % numberOfFrames;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			playhead = key;
+		}
+		wakeUp.notify_one();
+		if(deterministic)
+		{
+			waitForFrame(key);
+			waitForFrame(nextKey);
+		}
+
+		//when the playhead crosses a keyframe the next texture becomes the current one and only the new next is uploaded
+		drawnSlots[0] = currentSlot;
+		drawnSlots[1] = nextSlot;
+		int slot = slotFor(key, findSlot(nextKey));
+		if(slot != -1)
+		{
+			currentSlot = slot;
+		}
+		slot = slotFor(nextKey, currentSlot);
+		if(slot != -1)
+		{
+			nextSlot = slot;
+		}
+
+		//the last frame does not blend back into the first one
+		bool ready = slotFrames[currentSlot] == key && slotFrames[nextSlot] == nextKey;
+		blend = ready && nextKey != 0 ? position - key : 0.0f;
+	}
+
+	//Jumps by a number of frames, wrapping around the sequence
+	void step(const int frames)
+	{
+		if(numberOfFrames == 0)
+		{
+			return;
+		}
+		int frame = ((int)position + frames) % numberOfFrames;
+		if(frame < 0)
+		{
+			frame += numberOfFrames;
+		}
+		position = frame;
+	}
+
+	//Texture of the keyframe before the playhead: R is the lava thickness, G the normalized temperature
+	unsigned int getTexture()
+	{
+		return textures[currentSlot];
+	}
+
+	//Texture of the keyframe after the playhead
+	unsigned int getNextTexture()
+	{
+		return textures[nextSlot];
+	}
+
+	//How far the playhead is from the current keyframe towards the next one, in [0, 1)
+	float getBlend()
+	{
+		return blend;
+	}
+
+	int getDisplayedFrame()
+	{
+		return slotFrames[currentSlot];
+	}
+
+	//Cells of the keyframe before the playhead, thickness and normalized temperature interleaved, empty before the first
+	const std::vector<float>& getCells()
+	{
+		return slotCells[currentSlot];
+	}
+
+	//Paused with the keyframes around the playhead uploaded: updating again would draw the same
+	bool isSettled()
+	{
+		return numberOfFrames == 0 || (!playing && slotFrames[currentSlot] == (int)position
+			&& slotFrames[nextSlot] == ((int)position + 1) % numberOfFrames);
+	}
+
+	bool playing;
+	float framesPerSecond;
+	//Waits in update for the keyframes around the playhead, so that a frame drawn at a given time is the same in every run
+	bool deterministic;
+
+	private:
+		std::string lavaPattern;
+		std::string temperaturePattern;
+		//only read by the decoder thread
+		std::unique_ptr<LavaSeriesReader> lavaSeries;
+		std::unique_ptr<LavaSeriesReader> temperatureSeries;
+		int prefetchFrames;
+		int numberOfFrames;
+		int rows;
+		int columns;
+		//range of the temperatures of every frame, only used by the decoder thread
+		float minTemperature;
+		float maxTemperature;
+		float position;
+		float blend;
+		int currentSlot;
+		int nextSlot;
+		int drawnSlots[2];
+		unsigned int textures[PLAYBACK_BUFFERS];
+		unsigned int pixelBuffers[PLAYBACK_BUFFERS];
+		//frame held by every texture, -1 if none, and a copy of its cells to find what the next upload changes
+		int slotFrames[PLAYBACK_BUFFERS];
+		std::vector<float> slotCells[PLAYBACK_BUFFERS];
+
+		//shared with the decoder thread
+		std::thread decoder;
+		std::mutex mutex;
+		std::condition_variable wakeUp;
+		std::condition_variable frameDecoded;
+		std::map<int, std::vector<float> > decoded;
+		int playhead;
+		bool stopping;
+
+		void stopDecoder()
+		{
+			if(decoder.joinable())
+			{
+				{
+					std::lock_guard<std::mutex> lock(mutex);
+					stopping = true;
+				}
+				wakeUp.notify_one();
+				frameDecoded.notify_all();
+				decoder.join();
+				stopping = false;
+			}
+		}
+
+		unsigned int frameBytes()
+		{
+			return rows * columns * 2 * sizeof(float);
+		}
+
+		//Returns once the frame is in a texture or decoded, ready for slotFor
+		void waitForFrame(const int frame)
+		{
+			if(findSlot(frame) != -1)
+			{
+				return;
+			}
+			std::unique_lock<std::mutex> lock(mutex);
+			while(!stopping && decoded.find(frame) == decoded.end())
+			{
+				frameDecoded.wait(lock);
+			}
+		}
+
+		int findSlot(const int frame)
+		{
+			for(int k=0; k<PLAYBACK_BUFFERS; k++)
+			{
+				if(slotFrames[k] == frame)
+				{
+					return k;
+				}
+			}
+			return -1;
+		}
+
+		//Slot holding the frame, uploading it if needed into a slot other than reserved, preferably one not drawn last frame.
+		//Returns -1 if the frame has not been decoded yet
+		int slotFor(const int frame, const int reserved)
+		{
+			int slot = findSlot(frame);
+			if(slot != -1)
+			{
+				return slot;
+			}
+
+			for(int k=0; k<PLAYBACK_BUFFERS; k++)
+			{
+				if(k != reserved && k != drawnSlots[0] && k != drawnSlots[1])
+				{
+					slot = k;
+				}
+			}
+			for(int k=0; k<PLAYBACK_BUFFERS && slot == -1; k++)
+			{
+				if(k != reserved)
+				{
+					slot = k;
+				}
+			}
+
+			if(!uploadFrame(frame, slot))
+			{
+				return -1;
+			}
+			return slot;
+		}
+
+		//Uploads only the rectangle of cells that differ from the frame already in the texture: between close frames the
+		//flow front is a small part of the grid
+		bool uploadFrame(const int frame, const int slot)
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			std::map<int, std::vector<float> >::iterator found = decoded.find(frame);
+			if(found == decoded.end())
+			{
+				return false;
+			}
+			const std::vector<float>& cells = found->second;
+			std::vector<float>& uploaded = slotCells[slot];
+
+			int firstRow = 0;
+			int lastRow = rows - 1;
+			int firstColumn = 0;
+			int lastColumn = columns - 1;
+			if(uploaded.size() == cells.size())
+			{
+				changedRectangle(uploaded, cells, firstRow, lastRow, firstColumn, lastColumn);
+			}
+			else
+			{
+				uploaded.assign(cells.size(), 0.0f);
+			}
+
+			if(firstRow <= lastRow)
+			{
+				const int width = lastColumn - firstColumn + 1;
+				const int height = lastRow - firstRow + 1;
+				const unsigned int rowBytes = width * 2 * sizeof(float);
+				glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pixelBuffers[slot]);
+				char* destination = (char*)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, rowBytes * height, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+				if(destination == NULL)
+				{
+					uploaded.clear();
+					glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+					return false;
+				}
+				for(int i=firstRow; i<=lastRow; i++)
+				{
+					const size_t first = ((size_t)i * columns + firstColumn) * 2;
+					std::memcpy(destination + (size_t)(i - firstRow) * rowBytes, &cells[first], rowBytes);
+					std::memcpy(&uploaded[first], &cells[first], rowBytes);
+				}
+				glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+				lock.unlock();
+
+				glBindTexture(GL_TEXTURE_2D, textures[slot]);
+				glTexSubImage2D(GL_TEXTURE_2D, 0, firstColumn, firstRow, width, height, GL_RG, GL_FLOAT, 0);
+				glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+			}
+
+			slotFrames[slot] = frame;
+			return true;
+		}
+
+		//Bounding rectangle of the cells that differ, empty (firstRow > lastRow) if none
+		void changedRectangle(const std::vector<float>& before, const std::vector<float>& after, int& firstRow, int& lastRow,
+			int& firstColumn, int& lastColumn)
+		{
+			const size_t rowFloats = (size_t)columns * 2;
+			firstRow = rows;
+			lastRow = -1;
+			firstColumn = columns;
+			lastColumn = -1;
+			for(int i=0; i<rows; i++)
+			{
+				const float* a = &before[i * rowFloats];
+				const float* b = &after[i * rowFloats];
+				if(std::memcmp(a, b, rowFloats * sizeof(float)) == 0)
+				{
+					continue;
+				}
+				firstRow = std::min(firstRow, i);
+				lastRow = i;
+				int j = 0;
+				while(j < firstColumn && a[j * 2] == b[j * 2] && a[j * 2 + 1] == b[j * 2 + 1])
+				{
+					j++;
+				}
+				firstColumn = j;
+				j = columns - 1;
+				while(j > lastColumn && a[j * 2] == b[j * 2] && a[j * 2 + 1] == b[j * 2 + 1])
+				{
+					j--;
+				}
+				lastColumn = j;
+			}
+		}
+
+		//Keeps decoded the frames from the playhead to prefetchFrames ahead, dropping the others, once the temperature range
+		//of the sequence is known
+		void decodeLoop()
+		{
+			readTemperatureRange();
+			std::unique_lock<std::mutex> lock(mutex);
+			while(!stopping)
+			{
+				int missing = -1;
+				for(int k=0; k<prefetchFrames && k<numberOfFrames; k++)
+				{
+					int frame = (playhead + k) % numberOfFrames;
+					if(decoded.find(frame) == decoded.end())
+					{
+						missing = frame;
+						break;
+					}
+				}
+
+				if(missing == -1)
+				{
+					wakeUp.wait(lock);
+					continue;
+				}
+
+				lock.unlock();
+				std::vector<float> cells;
+				loadFrame(missing, cells);
+				lock.lock();
+
+				decoded[missing].swap(cells);
+				frameDecoded.notify_all();
+				for(std::map<int, std::vector<float> >::iterator it=decoded.begin(); it!=decoded.end(); )
+				{
+					int ahead = (it->first - playhead + numberOfFrames) % numberOfFrames;
+					if(ahead >= prefetchFrames)
+					{
+						decoded.erase(it++);
+					}
+					else
+					{
+						++it;
+					}
+				}
+			}
+		}
+
+		void loadFrame(const int frame, std::vector<float>& cells)
+		{
+			cells.assign(rows * columns * 2, 0.0f);
+
+			Matrix lava;
+			Matrix temperature;
+			if(lavaSeries)
+			{
+				lavaSeries->readFrame(frame, lava);
+				temperatureSeries->readFrame(frame, temperature);
+			}
+			else
+			{
+				lava.loadFile(framePath(lavaPattern, frame));
+				temperature.loadFile(framePath(temperaturePattern, frame));
+			}
+			if(!lava.isLoaded() || !temperature.isLoaded() || lava.getRows() != rows || lava.getColumns() != columns
+				|| temperature.getRows() != rows || temperature.getColumns() != columns)
+			{
+				std::cout << "Lava frame " << frame << " does not match the " << rows << "x" << columns << " terrain" << std::endl;
+				return;
+			}
+
+			const float temperatureRange = maxTemperature - minTemperature;
+			for(int i=0; i<rows; i++)
+			{
+				for(int j=0; j<columns; j++)
+				{
+					float redValue = temperature.getValue(i, j);
+					if(redValue != 0 && temperatureRange > 0.0f)
+					{
+						redValue = (redValue - minTemperature) / temperatureRange;
+					}
+					cells[(i * columns + j) * 2] = lava.getValue(i, j);
+					cells[(i * columns + j) * 2 + 1] = redValue;
+				}
+			}
+		}
+
+		//Over every frame: the series have it from their records, the frame files are all read once
+		void readTemperatureRange()
+		{
+			if(temperatureSeries)
+			{
+				temperatureSeries->readRange(minTemperature, maxTemperature);
+				return;
+			}
+			minTemperature = std::numeric_limits<float>::max();
+			maxTemperature = -std::numeric_limits<float>::max();
+			for(int frame=0; frame<numberOfFrames; frame++)
+			{
+				Matrix temperature;
+				temperature.loadFile(framePath(temperaturePattern, frame));
+				if(temperature.isLoaded())
+				{
+					minTemperature = std::min(minTemperature, temperature.getMinValue());
+					maxTemperature = std::max(maxTemperature, temperature.getMaxValue());
+				}
+			}
+		}
+
+		std::string framePath(const std::string& pattern, const int frame)
+		{
+			char path[1024];
+			std::snprintf(path, sizeof(path), pattern.c_str(), frame);
+			return path;
+		}
+
+		bool isSeries(const std::string& path)
+		{
+			const std::string extension = ".lvs";
+			return path.size() > extension.size() && path.compare(path.size() - extension.size(), extension.size(), extension) == 0;
+		}
+
+		bool fileExists(const std::string& path)
+		{
+			std::ifstream file(path);
+			return file.good();
+		}
+};
+
+#endif
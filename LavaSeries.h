@@ -0,0 +1,368 @@
+#ifndef LAVASERIES_H
+#define LAVASERIES_H
+
+#include "Matrix.h"
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <cstring>
+#include <limits>
+#include <algorithm>
+
+//Time series of one grid per timestep, for the output of long simulations where most cells are zero and
+//consecutive steps differ only at the flow front. Layout, little endian:
+//  header   "LVS1", rows, columns, cellSize, noDataValue, keyframeInterval
+//  frames   one record per timestep: type (0 keyframe, 1 delta), number of cells, the cell indices as varint gaps,
+//           the cell values as floats. A keyframe lists the non zero cells, a delta the cells changed since the previous step
+//  index    offset of every record, number of frames, offset of the index, "LVSI"
+//Any frame is rebuilt from the closest keyframe before it, so a seek costs at most keyframeInterval records.
+const char LAVA_SERIES_MAGIC[4] = {'L', 'V', 'S', '1'};
+const char LAVA_SERIES_INDEX_MAGIC[4] = {'L', 'V', 'S', 'I'};
+const unsigned char LAVA_SERIES_KEYFRAME = 0;
+const unsigned char LAVA_SERIES_DELTA = 1;
+
+class LavaSeriesWriter
+{
+	public:
+	LavaSeriesWriter(const std::string& path, const int rows, const int columns, const float cellSize, const float noDataValue, const unsigned int keyframeInterval = 32):
+	rows(rows), columns(columns), keyframeInterval(keyframeInterval), previous(rows * columns, 0.0f), closed(false)
+	{
+		//refused as the reader does: the frames are rebuilt from the keyframes every keyframeInterval steps
+		if(keyframeInterval == 0)
+		{
+			std::cout << "Lava series needs a keyframe interval of at least 1, not written at path: " << path << std::endl;
+			return;
+		}
+		file.open(path.c_str(), std::ios::binary);
+		if(!file.is_open())
+		{
+			std::cout << "Lava series failed to open at path: " << path << std::endl;
+			return;
+		}
+		file.write(LAVA_SERIES_MAGIC, 4);
+		write(rows);
+		write(columns);
+		write(cellSize);
+		write(noDataValue);
+		write(keyframeInterval);
+	}
+
+	~LavaSeriesWriter()
+	{
+		close();
+	}
+
+	void addFrame(Matrix& frame)
+	{
+		if(frame.getRows() != rows || frame.getColumns() != columns)
+		{
+			std::cout << "Lava series frame is " << frame.getRows() << "x" << frame.getColumns() << " instead of " << rows << "x" << columns << std::endl;
+			return;
+		}
+
+		std::vector<float> cells(rows * columns);
+		for(int i=0; i<rows; i++)
+		{
+			for(int j=0; j<columns; j++)
+			{
+				cells[i * columns + j] = frame.getValue(i, j);
+			}
+		}
+		addFrame(cells);
+	}
+
+	//cells holds rows * columns values, row by row
+	void addFrame(const std::vector<float>& cells)
+	{
+		if(!file.is_open() || closed)
+		{
+			return;
+		}
+
+		const bool keyframe = offsets.size() % keyframeInterval == 0;
+		if(keyframe)
+		{
+			std::fill(previous.begin(), previous.end(), 0.0f);
+		}
+
+		std::vector<unsigned int> changed;
+		for(unsigned int c=0; c<cells.size(); c++)
+		{
+			if(cells[c] != previous[c])
+			{
+				changed.push_back(c);
+			}
+		}
+
+		offsets.push_back((unsigned long long)file.tellp());
+		file.put(keyframe ? LAVA_SERIES_KEYFRAME : LAVA_SERIES_DELTA);
+		write((unsigned int)changed.size());
+
+		unsigned int last = 0;
+		std::vector<unsigned char> packed;
+		for(unsigned int k=0; k<changed.size(); k++)
+		{
+			writeVarint(packed, changed[k] - last);
+			last = changed[k];
+		}
+		write((unsigned int)packed.size());
+		if(!packed.empty())
+		{
+			file.write((const char*)&packed[0], packed.size());
+		}
+		for(unsigned int k=0; k<changed.size(); k++)
+		{
+			write(cells[changed[k]]);
+		}
+
+		previous = cells;
+	}
+
+	//Writes the index: the series is unreadable until then
+	void close()
+	{
+		if(!file.is_open() || closed)
+		{
+			return;
+		}
+		closed = true;
+
+		unsigned long long indexOffset = file.tellp();
+		for(unsigned int f=0; f<offsets.size(); f++)
+		{
+			write(offsets[f]);
+		}
+		write((unsigned int)offsets.size());
+		write(indexOffset);
+		file.write(LAVA_SERIES_INDEX_MAGIC, 4);
+		file.close();
+	}
+
+	private:
+		std::ofstream file;
+		int rows;
+		int columns;
+		unsigned int keyframeInterval;
+		std::vector<float> previous;
+		std::vector<unsigned long long> offsets;
+		bool closed;
+
+		template <typename T>
+		void write(const T& value)
+		{
+			file.write((const char*)&value, sizeof(T));
+		}
+
+		void writeVarint(std::vector<unsigned char>& packed, unsigned int value)
+		{
+			while(value >= 0x80)
+			{
+				packed.push_back((unsigned char)(value | 0x80));
+				value >>= 7;
+			}
+			packed.push_back((unsigned char)value);
+		}
+};
+
+class LavaSeriesReader
+{
+	public:
+	LavaSeriesReader(const std::string& path):file(path.c_str(), std::ios::binary), rows(0), columns(0), cellSize(0), noDataValue(0),
+	keyframeInterval(1), currentFrame(-1), valid(false)
+	{
+		if(!file.is_open())
+		{
+			return;
+		}
+
+		char magic[4];
+		file.read(magic, 4);
+		if(!file || std::memcmp(magic, LAVA_SERIES_MAGIC, 4) != 0)
+		{
+			return;
+		}
+		read(rows);
+		read(columns);
+		read(cellSize);
+		read(noDataValue);
+		read(keyframeInterval);
+
+		unsigned int numberOfFrames = 0;
+		unsigned long long indexOffset = 0;
+		file.seekg(-(std::streamoff)(sizeof(unsigned int) + sizeof(unsigned long long) + 4), std::ios::end);
+		read(numberOfFrames);
+		read(indexOffset);
+		file.read(magic, 4);
+		if(!file || std::memcmp(magic, LAVA_SERIES_INDEX_MAGIC, 4) != 0 || keyframeInterval == 0)
+		{
+			return;
+		}
+
+		offsets.resize(numberOfFrames);
+		file.seekg(indexOffset);
+		for(unsigned int f=0; f<numberOfFrames; f++)
+		{
+			read(offsets[f]);
+		}
+		cells.assign(rows * columns, 0.0f);
+		valid = (bool)file;
+	}
+
+	bool isValid()
+	{
+		return valid;
+	}
+
+	int getNumberOfFrames()
+	{
+		return offsets.size();
+	}
+
+	int getRows()
+	{
+		return rows;
+	}
+
+	int getColumns()
+	{
+		return columns;
+	}
+
+	//Cells of the frame, row by row. Reading the frames in order applies a single record each
+	const std::vector<float>& readFrame(const int frame)
+	{
+		if(!valid || frame < 0 || frame >= (int)offsets.size())
+		{
+			return cells;
+		}
+
+		int first = (frame / keyframeInterval) * keyframeInterval;
+		if(currentFrame >= first && currentFrame <= frame)
+		{
+			first = currentFrame + 1;
+		}
+		for(int f=first; f<=frame; f++)
+		{
+			applyRecord(f);
+		}
+		currentFrame = frame;
+		return cells;
+	}
+
+	//Smallest and largest value of every frame but the no data ones, as Matrix::computeRange, from the values of the
+	//records without rebuilding the frames: the cells a keyframe leaves out are zero
+	void readRange(float& minValue, float& maxValue)
+	{
+		minValue = std::numeric_limits<float>::max();
+		maxValue = -std::numeric_limits<float>::max();
+		for(unsigned int f=0; valid && f<offsets.size(); f++)
+		{
+			file.clear();
+			file.seekg(offsets[f]);
+			unsigned char type = file.get();
+			unsigned int count = 0;
+			unsigned int packedSize = 0;
+			read(count);
+			read(packedSize);
+			file.seekg(packedSize, std::ios::cur);
+			if(type == LAVA_SERIES_KEYFRAME && count < cells.size() && noDataValue != 0.0f)
+			{
+				minValue = std::min(minValue, 0.0f);
+				maxValue = std::max(maxValue, 0.0f);
+			}
+			for(unsigned int k=0; k<count; k++)
+			{
+				float value = 0.0f;
+				read(value);
+				if(value != noDataValue)
+				{
+					minValue = std::min(minValue, value);
+					maxValue = std::max(maxValue, value);
+				}
+			}
+		}
+	}
+
+	void readFrame(const int frame, Matrix& matrix)
+	{
+		const std::vector<float>& values = readFrame(frame);
+		matrix.allocate(rows, columns, cellSize, noDataValue);
+		for(int i=0; i<rows; i++)
+		{
+			for(int j=0; j<columns; j++)
+			{
+				matrix.setValue(i, j, values[i * columns + j]);
+			}
+		}
+		matrix.computeRange();
+	}
+
+	private:
+		std::ifstream file;
+		int rows;
+		int columns;
+		float cellSize;
+		float noDataValue;
+		unsigned int keyframeInterval;
+		std::vector<unsigned long long> offsets;
+		std::vector<float> cells;
+		std::vector<unsigned char> packed;
+		int currentFrame;
+		bool valid;
+
+		template <typename T>
+		void read(T& value)
+		{
+			file.read((char*)&value, sizeof(T));
+		}
+
+		void applyRecord(const int frame)
+		{
+			file.clear();
+			file.seekg(offsets[frame]);
+			unsigned char type = file.get();
+			if(type == LAVA_SERIES_KEYFRAME)
+			{
+				std::fill(cells.begin(), cells.end(), 0.0f);
+			}
+
+			unsigned int count = 0;
+			unsigned int packedSize = 0;
+			read(count);
+			read(packedSize);
+			packed.resize(packedSize);
+			if(packedSize > 0)
+			{
+				file.read((char*)&packed[0], packedSize);
+			}
+
+			unsigned int cell = 0;
+			unsigned int position = 0;
+			for(unsigned int k=0; k<count && position<packedSize; k++)
+			{
+				unsigned int gap = 0;
+				int shift = 0;
+				while(position < packedSize)
+				{
+					unsigned char byte = packed[position++];
+					gap |= (unsigned int)(byte & 0x7F) << shift;
+					shift += 7;
+					if(!(byte & 0x80))
+					{
+						break;
+					}
+				}
+				cell += gap;
+
+				float value = 0.0f;
+				read(value);
+				if(cell < cells.size())
+				{
+					cells[cell] = value;
+				}
+			}
+		}
+};
+
+#endif
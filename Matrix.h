@@ -15,6 +15,7 @@
 #include <vector>
 #include <cfloat>
 #include <limits>
+#include <algorithm>
 
 class Matrix
 {
@@ -32,10 +33,7 @@ class Matrix
 
 		~Matrix()
 	    {
-	        for (int i = 0; i < rows; ++i) {
-	            delete [] matrix[i];
-	        }
-	        delete [] matrix;
+	        release();
 	    }
 
 	    bool isLoaded()
@@ -142,6 +140,11 @@ class Matrix
 	        return minValue;
 	    }
 
+	    float getNoDataValue()
+	    {
+	        return noDataValue;
+	    }
+
 	    int getColumns()
 	    {
 	        return columns;
@@ -158,6 +161,77 @@ class Matrix
 	    	return matrix[i][j];
 	    }
 
+	    //Memory taken by the values, 0 if not loaded
+	    size_t getBytes()
+	    {
+	        return matrix == NULL ? 0 : rows * (columns * sizeof(float) + sizeof(float*));
+	    }
+
+	    //Back to the state of a matrix never loaded
+	    void clear()
+	    {
+	        release();
+	        rows = 0;
+	        columns = 0;
+	        maxValue = -std::numeric_limits<float>::max();
+	        minValue = std::numeric_limits<float>::max();
+	    }
+
+	    //Replaces the content with a rows x columns grid of zeros, to be filled with setValue
+	    void allocate(const int newRows, const int newColumns, const float newCellSize, const float newNoDataValue)
+	    {
+	        if(matrix == NULL || rows != newRows || columns != newColumns)
+	        {
+	            release();
+	            rows = newRows;
+	            columns = newColumns;
+	            matrix = new float* [rows];
+	            for(int i=0; i<rows; i++)
+	            {
+	                matrix[i] = new float[columns];
+	            }
+	        }
+	        for(int i=0; i<rows; i++)
+	        {
+	            std::fill(matrix[i], matrix[i] + columns, 0.0f);
+	        }
+	        cellSize = newCellSize;
+	        noDataValue = newNoDataValue;
+	        maxValue = -std::numeric_limits<float>::max();
+	        minValue = std::numeric_limits<float>::max();
+	    }
+
+	    //The columns of row i, contiguous
+	    float* getRow(const int i)
+	    {
+	    	assert(matrix!=NULL && i<rows);
+	    	return matrix[i];
+	    }
+
+	    void setValue(const int i, const int j, const float value)
+	    {
+	    	assert(matrix!=NULL && i<rows && j<columns);
+	    	matrix[i][j] = value;
+	    }
+
+	    //Updates the minimum and maximum after the values have been set
+	    void computeRange()
+	    {
+	        maxValue = -std::numeric_limits<float>::max();
+	        minValue = std::numeric_limits<float>::max();
+	        for(int i=0; i<rows; i++)
+	        {
+	            for(int j=0; j<columns; j++)
+	            {
+	                if(matrix[i][j] != noDataValue)
+	                {
+	                    maxValue = std::max(maxValue, matrix[i][j]);
+	                    minValue = std::min(minValue, matrix[i][j]);
+	                }
+	            }
+	        }
+	    }
+
 	private:
 		float ** matrix;
 		int columns;
@@ -167,6 +241,18 @@ class Matrix
 		float maxValue;
 		float minValue;
 
+		void release()
+		{
+			if(matrix != NULL)
+			{
+				for (int i = 0; i < rows; ++i) {
+					delete [] matrix[i];
+				}
+				delete [] matrix;
+			}
+			matrix = NULL;
+		}
+
 		std::vector<std::string> split(std::string str, char delimiter) 
 		{
 	        std::vector<std::string> internal;
@@ -0,0 +1,277 @@
+#ifndef MESHCACHE_H
+#define MESHCACHE_H
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <cstring>
+#include <cstdio>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#include <direct.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+//Binary files holding the meshes built from the grids, so that later launches copy them back in bulk instead of meshing.
+//An entry is named after a 64 bit hash of the content of the source grids and of the settings of the mesher,
+//and starts with the same hash and the version of the layout: bump MESH_CACHE_VERSION whenever the layout changes
+const char MESH_CACHE_MAGIC[4] = {'M', 'S', 'H', 'C'};
+const unsigned int MESH_CACHE_VERSION = 4;
+
+//FNV-1a, fed with the bytes of the sources and of the settings
+class MeshCacheKey
+{
+	public:
+	MeshCacheKey():hash(14695981039346656037ULL)
+	{}
+
+	void add(const void* data, const size_t size)
+	{
+		const unsigned char* bytes = (const unsigned char*)data;
+		for(size_t i=0; i<size; i++)
+		{
+			hash = (hash ^ bytes[i]) * 1099511628211ULL;
+		}
+	}
+
+	template <typename T>
+	void add(const T& value)
+	{
+		add(&value, sizeof(T));
+	}
+
+	//Adds the content of a file, or nothing if the path is empty or cannot be read
+	void addFile(const std::string& path)
+	{
+		std::ifstream file(path.c_str(), std::ios::binary);
+		std::vector<char> buffer(1 << 16);
+		while(file)
+		{
+			file.read(&buffer[0], buffer.size());
+			add(&buffer[0], file.gcount());
+		}
+		add(path.size());
+	}
+
+	unsigned long long getHash()
+	{
+		return hash;
+	}
+
+	//Path of the entry in a directory, created if missing
+	std::string getPath(const std::string& directory, const std::string& extension = ".mesh")
+	{
+#ifdef _WIN32
+		_mkdir(directory.c_str());
+#else
+		mkdir(directory.c_str(), 0755);
+#endif
+		char name[32];
+		std::snprintf(name, sizeof(name), "%016llx", hash);
+		return directory + "/" + name + extension;
+	}
+
+	private:
+		unsigned long long hash;
+};
+
+class MeshCacheWriter
+{
+	public:
+	//Writes to a temporary file renamed over path by close, so that a crash never leaves a truncated entry behind
+	MeshCacheWriter(const std::string& path, const unsigned long long key):path(path), file((path + ".tmp").c_str(), std::ios::binary)
+	{
+		file.write(MESH_CACHE_MAGIC, 4);
+		write(MESH_CACHE_VERSION);
+		write(key);
+		//size of the whole entry, known at close
+		write((unsigned long long)0);
+	}
+
+	template <typename T>
+	void write(const T& value)
+	{
+		file.write((const char*)&value, sizeof(T));
+	}
+
+	template <typename T>
+	void writeVector(const std::vector<T>& values)
+	{
+		write((unsigned long long)values.size());
+		writeArray(values.empty() ? NULL : &values[0], values.size());
+	}
+
+	template <typename T>
+	void writeArray(const T* values, const size_t count)
+	{
+		if(count > 0)
+		{
+			file.write((const char*)values, sizeof(T) * count);
+		}
+	}
+
+	bool close()
+	{
+		unsigned long long size = file.tellp();
+		file.seekp(4 + sizeof(unsigned int) + sizeof(unsigned long long));
+		write(size);
+		file.close();
+		if(!file)
+		{
+			std::remove((path + ".tmp").c_str());
+			std::cout << "Mesh cache failed to write at path: " << path << std::endl;
+			return false;
+		}
+		std::remove(path.c_str());
+		return std::rename((path + ".tmp").c_str(), path.c_str()) == 0;
+	}
+
+	private:
+		std::string path;
+		std::ofstream file;
+};
+
+//Maps an entry in memory: the tables are copied out of it with one memcpy each, or read in place through getArray
+class MeshCacheReader
+{
+	public:
+	MeshCacheReader(const std::string& path, const unsigned long long key):data(NULL), size(0), position(0), valid(false)
+	{
+#ifdef _WIN32
+		fileHandle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+		mappingHandle = NULL;
+		if(fileHandle == INVALID_HANDLE_VALUE)
+		{
+			return;
+		}
+		LARGE_INTEGER fileSize;
+		GetFileSizeEx(fileHandle, &fileSize);
+		size = fileSize.QuadPart;
+		mappingHandle = CreateFileMappingA(fileHandle, NULL, PAGE_READONLY, 0, 0, NULL);
+		if(mappingHandle != NULL)
+		{
+			data = (const char*)MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0);
+		}
+#else
+		int descriptor = ::open(path.c_str(), O_RDONLY);
+		if(descriptor == -1)
+		{
+			return;
+		}
+		struct stat status;
+		if(fstat(descriptor, &status) == 0 && status.st_size > 0)
+		{
+			size = status.st_size;
+			void* mapped = mmap(NULL, size, PROT_READ, MAP_PRIVATE, descriptor, 0);
+			data = mapped == MAP_FAILED ? NULL : (const char*)mapped;
+		}
+		::close(descriptor);
+#endif
+		if(data == NULL)
+		{
+			return;
+		}
+
+		unsigned int version = 0;
+		unsigned long long storedKey = 0;
+		unsigned long long storedSize = 0;
+		valid = size >= 4 && std::memcmp(data, MESH_CACHE_MAGIC, 4) == 0;
+		position = 4;
+		valid = valid && read(version) && read(storedKey) && read(storedSize)
+			&& version == MESH_CACHE_VERSION && storedKey == key && storedSize == size;
+	}
+
+	~MeshCacheReader()
+	{
+#ifdef _WIN32
+		if(data != NULL)
+		{
+			UnmapViewOfFile(data);
+		}
+		if(mappingHandle != NULL)
+		{
+			CloseHandle(mappingHandle);
+		}
+		if(fileHandle != INVALID_HANDLE_VALUE)
+		{
+			CloseHandle(fileHandle);
+		}
+#else
+		if(data != NULL)
+		{
+			munmap((void*)data, size);
+		}
+#endif
+	}
+
+	//False if the entry is missing, stale or truncated: the caller meshes from the sources instead
+	bool isValid()
+	{
+		return valid;
+	}
+
+	template <typename T>
+	bool read(T& value)
+	{
+		if(!valid || position + sizeof(T) > size)
+		{
+			valid = false;
+			return false;
+		}
+		std::memcpy(&value, data + position, sizeof(T));
+		position += sizeof(T);
+		return true;
+	}
+
+	template <typename T>
+	bool readVector(std::vector<T>& values)
+	{
+		unsigned long long count = 0;
+		const T* source = NULL;
+		if(!read(count) || (source = getArray<T>(count)) == NULL)
+		{
+			return false;
+		}
+		values.resize(count);
+		if(count > 0)
+		{
+			std::memcpy(&values[0], source, sizeof(T) * count);
+		}
+		return true;
+	}
+
+	//Pointer to count values inside the mapping, valid as long as the reader
+	template <typename T>
+	const T* getArray(const unsigned long long count)
+	{
+		if(!valid || count > (size - position) / sizeof(T))
+		{
+			valid = false;
+			return NULL;
+		}
+		const T* values = (const T*)(data + position);
+		position += sizeof(T) * count;
+		return values;
+	}
+
+	private:
+		const char* data;
+		size_t size;
+		size_t position;
+		bool valid;
+#ifdef _WIN32
+		HANDLE fileHandle;
+		HANDLE mappingHandle;
+#endif
+};
+
+#endif
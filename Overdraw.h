@@ -0,0 +1,115 @@
+#ifndef OVERDRAW_H
+#define OVERDRAW_H
+
+#include <glad/glad.h>
+
+#include <algorithm>
+
+//Frames counted in flight before their counts are read, without ever waiting for them
+const int OVERDRAW_QUERY_FRAMES = 4;
+
+//Fragments passing the depth test per pixel of the frame, counted by GL_SAMPLES_PASSED queries around the shading of the
+//terrain. The depth test runs before the fragment shader, so the fragments failing it are never shaded: the count is the
+//shading work, 1 per covered pixel with a perfect front to back order or a depth pre-pass
+class OverdrawCounter
+{
+	public:
+	OverdrawCounter():next(0), active(false), created(false), fragments(0.0), pixels(0.0), frames(0)
+	{
+		std::fill(pending, pending + OVERDRAW_QUERY_FRAMES, false);
+	}
+
+	//Deletes the queries, with the GL context still current
+	void release()
+	{
+		if(created)
+		{
+			glDeleteQueries(OVERDRAW_QUERY_FRAMES, queries);
+		}
+		created = false;
+	}
+
+	void begin()
+	{
+		if(!created)
+		{
+			glGenQueries(OVERDRAW_QUERY_FRAMES, queries);
+			created = true;
+		}
+		active = !pending[next];
+		if(active)
+		{
+			glBeginQuery(GL_SAMPLES_PASSED, queries[next]);
+		}
+	}
+
+	//Ends the count of a frame of the given number of pixels
+	void end(const double framePixels)
+	{
+		if(!active)
+		{
+			return;
+		}
+		glEndQuery(GL_SAMPLES_PASSED);
+		pending[next] = true;
+		queryPixels[next] = framePixels;
+		next = (next + 1) % OVERDRAW_QUERY_FRAMES;
+		active = false;
+	}
+
+	//Adds the counts read back since the last call. Call it once per frame
+	void collect()
+	{
+		for(int q=0; q<OVERDRAW_QUERY_FRAMES; q++)
+		{
+			const int query = (next + q) % OVERDRAW_QUERY_FRAMES;
+			if(!pending[query])
+			{
+				continue;
+			}
+			GLint available = 0;
+			glGetQueryObjectiv(queries[query], GL_QUERY_RESULT_AVAILABLE, &available);
+			if(!available)
+			{
+				break;
+			}
+			GLuint64 samples = 0;
+			glGetQueryObjectui64v(queries[query], GL_QUERY_RESULT, &samples);
+			fragments += samples;
+			pixels += queryPixels[query];
+			frames++;
+			pending[query] = false;
+		}
+	}
+
+	//Shaded fragments per pixel over the frames collected since the last reset
+	double getFactor()
+	{
+		return pixels > 0.0 ? fragments / pixels : 0.0;
+	}
+
+	int getFrames()
+	{
+		return frames;
+	}
+
+	void reset()
+	{
+		fragments = 0.0;
+		pixels = 0.0;
+		frames = 0;
+	}
+
+	private:
+		unsigned int queries[OVERDRAW_QUERY_FRAMES];
+		double queryPixels[OVERDRAW_QUERY_FRAMES];
+		bool pending[OVERDRAW_QUERY_FRAMES];
+		int next;
+		bool active;
+		bool created;
+		double fragments;
+		double pixels;
+		int frames;
+};
+
+#endif
@@ -0,0 +1,359 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <glad/glad.h>
+
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <map>
+#include <thread>
+#include <mutex>
+#include <chrono>
+#include <algorithm>
+
+//Durations of the last PROFILE_WINDOW samples of a phase, counted in buckets doubling from 1 microsecond
+const int PROFILE_WINDOW = 256;
+const int PROFILE_BUCKETS = 24;
+//events kept for the trace, the later ones are only counted in the histograms
+const size_t PROFILE_MAX_EVENTS = 1000000;
+//thread of the GPU timings in the trace
+const int PROFILE_GPU_THREAD = 1000;
+
+class ProfileHistogram
+{
+	public:
+	ProfileHistogram():next(0), count(0), total(0.0)
+	{
+		std::fill(buckets, buckets + PROFILE_BUCKETS, 0);
+	}
+
+	void add(const double microseconds)
+	{
+		if(count == PROFILE_WINDOW)
+		{
+			buckets[bucket(samples[next])]--;
+			total -= samples[next];
+		}
+		else
+		{
+			samples.push_back(0.0);
+			count++;
+		}
+		samples[next] = microseconds;
+		buckets[bucket(microseconds)]++;
+		total += microseconds;
+		next = (next + 1) % PROFILE_WINDOW;
+	}
+
+	double getMean()
+	{
+		return count > 0 ? total / count : 0.0;
+	}
+
+	//Upper bound of the bucket holding the fraction of the samples
+	double getPercentile(const double fraction)
+	{
+		int below = 0;
+		for(int b=0; b<PROFILE_BUCKETS; b++)
+		{
+			below += buckets[b];
+			if(below >= fraction * count)
+			{
+				return (double)(1 << b);
+			}
+		}
+		return (double)(1 << (PROFILE_BUCKETS - 1));
+	}
+
+	double getMax()
+	{
+		return count > 0 ? *std::max_element(samples.begin(), samples.end()) : 0.0;
+	}
+
+	private:
+		std::vector<double> samples;
+		int buckets[PROFILE_BUCKETS];
+		int next;
+		int count;
+		double total;
+
+		static int bucket(const double microseconds)
+		{
+			int b = 0;
+			while(b < PROFILE_BUCKETS - 1 && (double)(1 << b) < microseconds)
+			{
+				b++;
+			}
+			return b;
+		}
+};
+
+struct ProfileEvent
+{
+	std::string name;
+	int thread;
+	//microseconds since the profiler started
+	double start;
+	double duration;
+};
+
+//Timeline of named phases on every thread, from the first file opened to the frames, kept in histograms per phase
+//and written as a Chrome trace (chrome://tracing, Perfetto). Does nothing until enabled
+class Profiler
+{
+	public:
+	static Profiler& get()
+	{
+		static Profiler profiler;
+		return profiler;
+	}
+
+	//Starts the timeline, the calling thread is named main
+	void enable()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		enabled = true;
+		begin = std::chrono::steady_clock::now();
+		threadNames[threadIndex()] = "main";
+	}
+
+	bool isEnabled()
+	{
+		return enabled;
+	}
+
+	void nameThread(const std::string& name)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		threadNames[threadIndex()] = name;
+	}
+
+	double now()
+	{
+		return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - begin).count();
+	}
+
+	//A phase of the calling thread, or of the GPU
+	void add(const std::string& name, const double start, const double duration, const bool gpu = false)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		const int thread = gpu ? PROFILE_GPU_THREAD : threadIndex();
+		histograms[gpu ? "gpu " + name : name].add(duration);
+		if(events.size() < PROFILE_MAX_EVENTS)
+		{
+			ProfileEvent event;
+			event.name = name;
+			event.thread = thread;
+			event.start = start;
+			event.duration = duration;
+			events.push_back(event);
+		}
+	}
+
+	//Last PROFILE_WINDOW samples of every phase
+	void printReport()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		std::cout << std::fixed << std::setprecision(1);
+		std::cout << "Profile (us, last " << PROFILE_WINDOW << " samples): mean, median, p95 and p99 bucket, max" << std::endl;
+		for(std::map<std::string, ProfileHistogram>::iterator h=histograms.begin(); h!=histograms.end(); h++)
+		{
+			ProfileHistogram& histogram = h->second;
+			std::cout << "  " << std::setw(10) << histogram.getMean() << " " << std::setw(8) << histogram.getPercentile(0.5) << " "
+				<< std::setw(8) << histogram.getPercentile(0.95) << " " << std::setw(8) << histogram.getPercentile(0.99) << " "
+				<< std::setw(10) << histogram.getMax() << "  " << h->first << std::endl;
+		}
+		std::cout << std::defaultfloat << std::setprecision(6);
+	}
+
+	bool writeTrace(const std::string& path)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		std::ofstream file(path.c_str());
+		file << std::fixed << std::setprecision(3);
+		file << "{\"traceEvents\":[" << std::endl;
+		for(std::map<int, std::string>::iterator t=threadNames.begin(); t!=threadNames.end(); t++)
+		{
+			file << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << t->first << ",\"args\":{\"name\":\"" << t->second << "\"}}," << std::endl;
+		}
+		file << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << PROFILE_GPU_THREAD << ",\"args\":{\"name\":\"GPU\"}}";
+		for(size_t e=0; e<events.size(); e++)
+		{
+			file << "," << std::endl << "{\"name\":\"" << events[e].name << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << events[e].thread
+				<< ",\"ts\":" << events[e].start << ",\"dur\":" << events[e].duration << "}";
+		}
+		file << std::endl << "]}" << std::endl;
+		if(!file)
+		{
+			std::cout << "Failed to write trace at path: " << path << std::endl;
+			return false;
+		}
+		std::cout << "Trace of " << events.size() << " events written at path: " << path << std::endl;
+		return true;
+	}
+
+	private:
+		Profiler():enabled(false), begin(std::chrono::steady_clock::now())
+		{}
+
+		bool enabled;
+		std::chrono::steady_clock::time_point begin;
+		std::mutex mutex;
+		std::map<std::thread::id, int> threads;
+		std::map<int, std::string> threadNames;
+		std::map<std::string, ProfileHistogram> histograms;
+		std::vector<ProfileEvent> events;
+
+		//Call it with the mutex locked
+		int threadIndex()
+		{
+			std::map<std::thread::id, int>::iterator thread = threads.find(std::this_thread::get_id());
+			if(thread != threads.end())
+			{
+				return thread->second;
+			}
+			const int index = threads.size();
+			threads[std::this_thread::get_id()] = index;
+			threadNames[index] = "thread " + std::to_string(index);
+			return index;
+		}
+};
+
+//Times the enclosing block on the calling thread
+class ProfileScope
+{
+	public:
+	ProfileScope(const char* name):name(name), start(Profiler::get().isEnabled() ? Profiler::get().now() : 0.0), ended(false)
+	{}
+
+	~ProfileScope()
+	{
+		end();
+	}
+
+	//Ends the phase before the block does
+	void end()
+	{
+		Profiler& profiler = Profiler::get();
+		if(!ended && profiler.isEnabled())
+		{
+			profiler.add(name, start, profiler.now() - start);
+		}
+		ended = true;
+	}
+
+	private:
+		const char* name;
+		double start;
+		bool ended;
+};
+
+//GL_TIME_ELAPSED queries per phase in rings of GPU_TIMER_FRAMES, read back frames later once available so that the CPU
+//never waits for the GPU. Phases cannot overlap, the queries of this kind do not nest. A phase whose ring is still full
+//of pending queries is not timed that frame
+const int GPU_TIMER_FRAMES = 4;
+
+class GpuTimer
+{
+	public:
+	GpuTimer():active(-1)
+	{}
+
+	//Deletes the queries, with the GL context still current
+	void release()
+	{
+		for(unsigned int r=0; r<rings.size(); r++)
+		{
+			glDeleteQueries(GPU_TIMER_FRAMES, rings[r].queries);
+		}
+		rings.clear();
+		active = -1;
+	}
+
+	void begin(const std::string& name)
+	{
+		if(!Profiler::get().isEnabled())
+		{
+			return;
+		}
+		int r = 0;
+		while(r < (int)rings.size() && rings[r].name != name)
+		{
+			r++;
+		}
+		if(r == (int)rings.size())
+		{
+			rings.push_back(Ring());
+			rings[r].name = name;
+			rings[r].next = 0;
+			glGenQueries(GPU_TIMER_FRAMES, rings[r].queries);
+			std::fill(rings[r].pending, rings[r].pending + GPU_TIMER_FRAMES, false);
+		}
+		Ring& ring = rings[r];
+		if(ring.pending[ring.next])
+		{
+			return;
+		}
+		ring.submitted[ring.next] = Profiler::get().now();
+		glBeginQuery(GL_TIME_ELAPSED, ring.queries[ring.next]);
+		active = r;
+	}
+
+	void end()
+	{
+		if(active == -1)
+		{
+			return;
+		}
+		Ring& ring = rings[active];
+		glEndQuery(GL_TIME_ELAPSED);
+		ring.pending[ring.next] = true;
+		ring.next = (ring.next + 1) % GPU_TIMER_FRAMES;
+		active = -1;
+	}
+
+	//Hands the finished queries to the profiler, in the trace at the time they were submitted. Call it once per frame
+	void collect()
+	{
+		for(unsigned int r=0; r<rings.size(); r++)
+		{
+			Ring& ring = rings[r];
+			//oldest first, stopping at the first still running
+			for(int q=0; q<GPU_TIMER_FRAMES; q++)
+			{
+				const int query = (ring.next + q) % GPU_TIMER_FRAMES;
+				if(!ring.pending[query])
+				{
+					continue;
+				}
+				GLint available = 0;
+				glGetQueryObjectiv(ring.queries[query], GL_QUERY_RESULT_AVAILABLE, &available);
+				if(!available)
+				{
+					break;
+				}
+				GLuint64 nanoseconds = 0;
+				glGetQueryObjectui64v(ring.queries[query], GL_QUERY_RESULT, &nanoseconds);
+				Profiler::get().add(ring.name, ring.submitted[query], nanoseconds / 1000.0, true);
+				ring.pending[query] = false;
+			}
+		}
+	}
+
+	private:
+		struct Ring
+		{
+			std::string name;
+			unsigned int queries[GPU_TIMER_FRAMES];
+			double submitted[GPU_TIMER_FRAMES];
+			bool pending[GPU_TIMER_FRAMES];
+			int next;
+		};
+		std::vector<Ring> rings;
+		int active;
+};
+
+#endif
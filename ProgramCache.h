@@ -0,0 +1,190 @@
+#ifndef PROGRAMCACHE_H
+#define PROGRAMCACHE_H
+
+#include <glad/glad.h>
+
+#include "shader.h"
+#include "MeshCache.h"
+#include <iostream>
+#include <string>
+#include <vector>
+#include <cstring>
+
+//From KHR_parallel_shader_compile, missing from the core only loader
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+
+//Linked programs saved as the binaries the driver gives back, next to the meshes, and loaded by the next launches
+//instead of compiling. An entry is named after a hash of the sources, the defines and the driver strings, so another
+//driver or an update of it misses and compiles again, as does a binary the driver refuses.
+//Programs are started before being finished. Drivers with KHR_parallel_shader_compile compile them together in the
+//background, isReady tells when one can be finished without waiting; the others compile them as they are started
+class ProgramCache
+{
+	public:
+	//Call it with the GL context current. The loader, the one given to glad, finds the entry point setting the compiler threads
+	ProgramCache(const std::string& directory, GLADloadproc loader = NULL):directory(directory), enabled(false), parallel(false)
+	{
+		GLint major = 0;
+		GLint minor = 0;
+		GLint formats = 0;
+		glGetIntegerv(GL_MAJOR_VERSION, &major);
+		glGetIntegerv(GL_MINOR_VERSION, &minor);
+		//core from 4.1, before it glad leaves glGetProgramBinary unloaded
+		if(major > 4 || (major == 4 && minor >= 1))
+		{
+			glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+		}
+		enabled = formats > 0;
+		parallel = hasExtension("GL_KHR_parallel_shader_compile") || hasExtension("GL_ARB_parallel_shader_compile");
+		if(parallel && loader != NULL)
+		{
+			MaxCompilerThreads setThreads = (MaxCompilerThreads)loader("glMaxShaderCompilerThreadsKHR");
+			if(setThreads == NULL)
+			{
+				setThreads = (MaxCompilerThreads)loader("glMaxShaderCompilerThreadsARB");
+			}
+			//as many threads as the driver allows
+			if(setThreads != NULL)
+			{
+				setThreads(0xFFFFFFFF);
+			}
+		}
+
+		const GLenum strings[] = {GL_VENDOR, GL_RENDERER, GL_VERSION, GL_SHADING_LANGUAGE_VERSION};
+		for(unsigned int s=0; s<4; s++)
+		{
+			const char* value = (const char*)glGetString(strings[s]);
+			driver += value != NULL ? value : "";
+			driver += "\n";
+		}
+		std::cout << "Program cache " << (enabled ? "on" : "off, no binary formats") << ", parallel compile " << (parallel ? "on" : "off") << std::endl;
+	}
+
+	//Links the program from its cached binary, or starts compiling it: finish it before use. The defines are lines
+	//added after the #version line of both sources
+	void start(Shader& shader, const std::string& name, const std::string& vertexCode, const std::string& fragmentCode, const std::string& defines = "")
+	{
+		const std::string vertex = Shader::addDefines(vertexCode, defines);
+		const std::string fragment = Shader::addDefines(fragmentCode, defines);
+		MeshCacheKey key;
+		addString(key, vertex);
+		addString(key, fragment);
+		addString(key, driver);
+
+		Pending program;
+		program.shader = &shader;
+		program.name = name;
+		program.path = key.getPath(directory, ".program");
+		program.key = key.getHash();
+		program.cached = false;
+		if(enabled)
+		{
+			MeshCacheReader reader(program.path, program.key);
+			unsigned int format = 0;
+			std::vector<char> binary;
+			program.cached = reader.isValid() && reader.read(format) && reader.readVector(binary) && shader.loadBinary(format, binary);
+		}
+		if(!program.cached)
+		{
+			shader.startCompile(vertex, fragment, "", enabled);
+		}
+		pending.push_back(program);
+	}
+
+	//True once finish would not wait for the program started for shader: always without parallel compile, where
+	//start has compiled it already
+	bool isReady(Shader& shader)
+	{
+		for(unsigned int p=0; p<pending.size(); p++)
+		{
+			if(pending[p].shader == &shader && parallel && !pending[p].cached)
+			{
+				GLint done = GL_FALSE;
+				glGetProgramiv(shader.ID, GL_COMPLETION_STATUS_KHR, &done);
+				return done != GL_FALSE;
+			}
+		}
+		return true;
+	}
+
+	//Waits for the program started for shader and saves it if compiled. False if it did not compile or link
+	bool finish(Shader& shader)
+	{
+		unsigned int p = 0;
+		while(p < pending.size() && pending[p].shader != &shader)
+		{
+			p++;
+		}
+		if(p == pending.size())
+		{
+			return shader.ID != 0;
+		}
+		Pending program = pending[p];
+		pending.erase(pending.begin() + p);
+		if(program.cached)
+		{
+			std::cout << "Program " << program.name << " loaded from the cache" << std::endl;
+			return true;
+		}
+
+		if(!shader.finishCompile())
+		{
+			return false;
+		}
+		GLenum format;
+		std::vector<char> binary;
+		if(enabled && shader.getBinary(format, binary))
+		{
+			MeshCacheWriter writer(program.path, program.key);
+			writer.write((unsigned int)format);
+			writer.writeVector(binary);
+			writer.close();
+		}
+		std::cout << "Program " << program.name << " compiled" << std::endl;
+		return true;
+	}
+
+	private:
+		typedef void (APIENTRYP MaxCompilerThreads)(GLuint count);
+
+		struct Pending
+		{
+			Shader* shader;
+			std::string name;
+			std::string path;
+			unsigned long long key;
+			bool cached;
+		};
+
+		std::string directory;
+		bool enabled;
+		bool parallel;
+		//vendor, renderer and versions, part of every key
+		std::string driver;
+		std::vector<Pending> pending;
+
+		static void addString(MeshCacheKey& key, const std::string& value)
+		{
+			key.add(value.size());
+			key.add(value.data(), value.size());
+		}
+
+		static bool hasExtension(const char* name)
+		{
+			GLint count = 0;
+			glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+			for(GLint e=0; e<count; e++)
+			{
+				const char* extension = (const char*)glGetStringi(GL_EXTENSIONS, e);
+				if(extension != NULL && std::strcmp(extension, name) == 0)
+				{
+					return true;
+				}
+			}
+			return false;
+		}
+};
+
+#endif
@@ -0,0 +1,227 @@
+#ifndef RTIN_H
+#define RTIN_H
+
+#include <vector>
+#include <cmath>
+#include <cfloat>
+#include <climits>
+#include <algorithm>
+
+//Version of the triangles produced, part of the mesh cache key: bump it when they change
+const unsigned int RTIN_VERSION = 2;
+
+//Right-triangulated irregular network over a grid of corner heights (Evans, Kirkpatrick, Townsend and Mapbox martini).
+//The grid is padded to a square of side 2^k + 1; the triangles are split only where the surface is farther than
+//maxError from them, or where they cover a cell marked as forced, which is always kept at full resolution.
+//A triangle lies inside the aligned square of side its longest extent, so limiting that extent to a power of two keeps
+//every triangle inside one block of that side. A big grid is triangulated one such block at a time, see
+//Surface::triangulateTiles: the blocks share the errors of the corners on their borders through seedError
+class Rtin
+{
+	public:
+	//rows and columns are counted in cells, heights and forced cells are set afterwards
+	Rtin(const int rows, const int columns):rows(rows), columns(columns), size(2), computed(false)
+	{
+		while(size - 1 < std::max(rows, columns))
+		{
+			size = (size - 1) * 2 + 1;
+		}
+		heights.assign((size_t)size * size, 0.0f);
+		forced.assign((size_t)size * size, 0);
+
+		//cells outside the grid must never be covered by a coarse triangle
+		for(int y=0; y<size - 1; y++)
+		{
+			for(int x=0; x<size - 1; x++)
+			{
+				if(y >= rows || x >= columns)
+				{
+					forceCell(y, x);
+				}
+			}
+		}
+	}
+
+	void setHeight(const int row, const int column, const float height)
+	{
+		heights[index(row, column)] = height;
+	}
+
+	//Forces the corners of the cell, which may lie one row or column before the grid to force its first corners
+	void forceCell(const int row, const int column)
+	{
+		for(int y=std::max(row, 0); y<=row + 1 && y<size; y++)
+		{
+			for(int x=std::max(column, 0); x<=column + 1 && x<size; x++)
+			{
+				forced[index(y, x)] = 1;
+			}
+		}
+	}
+
+	//Raises the error of a corner to one known from outside the grid before the errors are computed, for the corners on
+	//the border with a neighbouring block to split as they do there
+	void seedError(const int row, const int column, const float error)
+	{
+		if(errors.empty())
+		{
+			errors.assign((size_t)size * size, 0.0f);
+		}
+		errors[index(row, column)] = std::max(errors[index(row, column)], error);
+	}
+
+	//Error of a corner as the midpoint of a hypotenuse, over the triangles of this grid alone if not seeded
+	float getVertexError(const int row, const int column)
+	{
+		if(!computed)
+		{
+			computeErrors();
+		}
+		return errors[index(row, column)];
+	}
+
+	//Appends to triangles three (row, column) corner pairs per triangle, the first two ending its hypotenuse. Single cell
+	//triangles are emitted also for forced cells inside the grid: the caller drops the ones it does not want. Triangles
+	//spanning more than maxSize cells are split whatever their error. Can be called again with other bounds, the errors
+	//are computed once
+	void triangulate(const float maxError, std::vector<int>& triangles, const int maxSize = INT_MAX)
+	{
+		if(!computed)
+		{
+			computeErrors();
+		}
+
+		const int last = size - 1;
+		processTriangle(0, 0, last, last, last, 0, maxError, maxSize, triangles);
+		processTriangle(last, last, 0, 0, 0, last, maxError, maxSize, triangles);
+	}
+
+	//Vertical error of a triangle emitted by triangulate, from its first two corners: the largest distance between the surface
+	//and the triangle over the cells it covers
+	float getError(const int firstRow, const int firstColumn, const int secondRow, const int secondColumn)
+	{
+		//the diagonal of a single cell
+		if(std::abs(firstRow - secondRow) <= 1 && std::abs(firstColumn - secondColumn) <= 1)
+		{
+			return 0.0f;
+		}
+		return errors[index((firstRow + secondRow) >> 1, (firstColumn + secondColumn) >> 1)];
+	}
+
+	private:
+		int rows;
+		int columns;
+		int size;
+		std::vector<float> heights;
+		std::vector<unsigned char> forced;
+		std::vector<float> errors;
+		bool computed;
+
+		//64 bit, a grid of side 2^16 + 1 has more corners than an int counts
+		size_t index(const int row, const int column)
+		{
+			return (size_t)row * size + column;
+		}
+
+		//Error of every vertex as the midpoint of a hypotenuse, accumulated from the smaller triangles up to the two biggest,
+		//over the seeded errors if any
+		void computeErrors()
+		{
+			if(errors.empty())
+			{
+				errors.assign((size_t)size * size, 0.0f);
+			}
+			computed = true;
+
+			const long long tileSize = size - 1;
+			const long long numberOfSmallestTriangles = tileSize * tileSize;
+			const long long numberOfTriangles = numberOfSmallestTriangles * 2 - 2;
+			const long long lastLevelIndex = numberOfTriangles - numberOfSmallestTriangles;
+
+			for(long long i=numberOfTriangles - 1; i>=0; i--)
+			{
+				//walk down from one of the two biggest triangles following the bits of the id
+				long long id = i + 2;
+				int ax = 0, ay = 0, bx = 0, by = 0, cx = 0, cy = 0;
+				if(id & 1)
+				{
+					bx = by = cx = size - 1;
+				}
+				else
+				{
+					ax = ay = cy = size - 1;
+				}
+				while((id >>= 1) > 1)
+				{
+					int mx = (ax + bx) >> 1;
+					int my = (ay + by) >> 1;
+					if(id & 1)
+					{
+						bx = ax;
+						by = ay;
+						ax = cx;
+						ay = cy;
+					}
+					else
+					{
+						ax = bx;
+						ay = by;
+						bx = cx;
+						by = cy;
+					}
+					cx = mx;
+					cy = my;
+				}
+
+				int mx = (ax + bx) >> 1;
+				int my = (ay + by) >> 1;
+				size_t middle = index(my, mx);
+				if(forced[middle])
+				{
+					errors[middle] = FLT_MAX;
+					continue;
+				}
+
+				float interpolatedHeight = (heights[index(ay, ax)] + heights[index(by, bx)]) * 0.5f;
+				float middleError = std::max(errors[middle], std::fabs(interpolatedHeight - heights[middle]));
+
+				if(i < lastLevelIndex)
+				{
+					cx = mx + my - ay;
+					cy = my + ax - mx;
+					size_t leftChild = index((ay + cy) >> 1, (ax + cx) >> 1);
+					size_t rightChild = index((by + cy) >> 1, (bx + cx) >> 1);
+					middleError = std::max(middleError, std::max(errors[leftChild], errors[rightChild]));
+				}
+				errors[middle] = middleError;
+			}
+		}
+
+		void processTriangle(const int ax, const int ay, const int bx, const int by, const int cx, const int cy, const float maxError, const int maxSize, std::vector<int>& triangles)
+		{
+			//entirely in the padding
+			if(std::min(ax, std::min(bx, cx)) >= columns || std::min(ay, std::min(by, cy)) >= rows)
+			{
+				return;
+			}
+
+			int mx = (ax + bx) >> 1;
+			int my = (ay + by) >> 1;
+			bool tooBig = std::max(std::abs(ax - bx), std::abs(ay - by)) > maxSize;
+			if(std::abs(ax - cx) + std::abs(ay - cy) > 1 && (tooBig || errors[index(my, mx)] > maxError))
+			{
+				processTriangle(cx, cy, ax, ay, mx, my, maxError, maxSize, triangles);
+				processTriangle(bx, by, cx, cy, mx, my, maxError, maxSize, triangles);
+				return;
+			}
+
+			triangles.push_back(ay);
+			triangles.push_back(ax);
+			triangles.push_back(by);
+			triangles.push_back(bx);
+			triangles.push_back(cy);
+			triangles.push_back(cx);
+		}
+};
+
+#endif
@@ -0,0 +1,370 @@
+#ifndef SCENEMANAGER_H
+#define SCENEMANAGER_H
+
+#include <glad/glad.h>
+
+#include "Surface.h"
+#include "TerrainLod.h"
+#include "MeshCache.h"
+#include "TaskGraph.h"
+#include "Profiler.h"
+#include <iostream>
+#include <string>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+enum SceneState
+{
+	SCENE_UNLOADED,
+	//queued or being meshed by the loader thread
+	SCENE_LOADING,
+	//meshed, waiting for the upload on the render thread
+	SCENE_LOADED,
+	//being sent to the GPU a slice per frame
+	SCENE_UPLOADING,
+	SCENE_RESIDENT
+};
+
+struct Scene
+{
+	std::string name;
+	std::string pathAltitude;
+	std::string pathLava;
+	std::string pathTemperature;
+	std::string pathTexture;
+	SurfaceSettings settings;
+	//what the surface keeps on the CPU once uploaded
+	SurfaceResidency residency;
+
+	std::unique_ptr<Surface> surface;
+	std::unique_ptr<TerrainLod> lod;
+	SceneState state;
+	//frame of the last request, for the eviction
+	unsigned long long lastUsed;
+	//memory taken by the scene on the CPU and on the GPU once resident
+	size_t cpuBytes;
+	size_t gpuBytes;
+};
+
+//Scenes registered by path and loaded only when first requested: a background thread reads them from the mesh cache or
+//meshes them and decodes their texture, the render thread uploads them uploadBytesPerFrame at a time so that no frame
+//stalls on a whole scene. When the resident scenes go over the memory budget the least recently requested ones are
+//dropped from both CPU and GPU memory, to be loaded again if requested later
+class SceneManager
+{
+	public:
+	//upload creates the vertex arrays of a meshed surface on the render thread, with buffers of the right size left empty
+	SceneManager(const std::string& cacheDirectory, const size_t memoryBudget, const size_t uploadBytesPerFrame, void (*upload)(Surface&)):
+	memoryBudget(memoryBudget), uploadBytesPerFrame(uploadBytesPerFrame), cacheDirectory(cacheDirectory), upload(upload), frame(0), stopping(false)
+	{
+		loader = std::thread(&SceneManager::loadLoop, this);
+	}
+
+	~SceneManager()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping = true;
+		}
+		wakeUp.notify_one();
+		loader.join();
+	}
+
+	//Only stores the paths: nothing is read before the scene is requested. An empty path leaves that grid out
+	int addScene(const std::string& name, const std::string& pathAltitude, const std::string& pathLava, const std::string& pathTemperature,
+		const std::string& pathTexture, const SurfaceSettings& settings, const SurfaceResidency residency = RESIDENCY_METADATA)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		scenes.push_back(std::unique_ptr<Scene>(new Scene()));
+		Scene& scene = *scenes.back();
+		scene.name = name;
+		scene.pathAltitude = pathAltitude;
+		scene.pathLava = pathLava;
+		scene.pathTemperature = pathTemperature;
+		scene.pathTexture = pathTexture;
+		scene.settings = settings;
+		scene.residency = residency;
+		scene.state = SCENE_UNLOADED;
+		scene.lastUsed = 0;
+		scene.cpuBytes = 0;
+		scene.gpuBytes = 0;
+		return scenes.size() - 1;
+	}
+
+	int getNumberOfScenes()
+	{
+		return scenes.size();
+	}
+
+	const std::string& getName(const int id)
+	{
+		return scenes[id]->name;
+	}
+
+	//The scene ready to be drawn, or NULL while it is being loaded: the first request starts loading it
+	Scene* request(const int id)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		Scene& scene = *scenes[id];
+		scene.lastUsed = frame;
+		if(scene.state == SCENE_UNLOADED)
+		{
+			scene.state = SCENE_LOADING;
+			queue.push_back(id);
+			wakeUp.notify_one();
+		}
+		return scene.state == SCENE_RESIDENT ? &scene : NULL;
+	}
+
+	//Uploads a slice of the scene being uploaded, or starts with one loaded since the last call, then evicts over the budget.
+	//Call it once per frame on the render thread
+	void update()
+	{
+		frame++;
+
+		Scene* uploading = NULL;
+		bool starting = false;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			for(unsigned int s=0; s<scenes.size() && uploading==NULL; s++)
+			{
+				if(scenes[s]->state == SCENE_UPLOADING)
+				{
+					uploading = scenes[s].get();
+				}
+			}
+			for(unsigned int s=0; s<scenes.size() && uploading==NULL; s++)
+			{
+				if(scenes[s]->state == SCENE_LOADED)
+				{
+					uploading = scenes[s].get();
+					uploading->state = SCENE_UPLOADING;
+					starting = true;
+				}
+			}
+		}
+		if(starting)
+		{
+			upload(*uploading->surface);
+			uploading->surface->allocateTexture();
+		}
+		if(uploading != NULL)
+		{
+			ProfileScope scope("scene upload slice");
+			if(uploading->surface->uploadSlice(uploadBytesPerFrame))
+			{
+				makeResident(*uploading);
+			}
+		}
+
+		evict();
+	}
+
+	//Whether a scene is being loaded or uploaded, needing update calls to become resident
+	bool isBusy()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		for(unsigned int s=0; s<scenes.size(); s++)
+		{
+			if(scenes[s]->state != SCENE_UNLOADED && scenes[s]->state != SCENE_RESIDENT)
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+
+	//Loads a scene through a task graph instead of the loader thread, for the startup: the mesh and the texture are read
+	//by two worker tasks, then uploaded whole by a main thread task. Returns the upload task, for the tasks needing the scene
+	int preload(const int id, TaskGraph& graph)
+	{
+		Scene& scene = *scenes[id];
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			scene.state = SCENE_LOADING;
+			scene.lastUsed = frame;
+			scene.surface.reset(new Surface());
+			scene.lod.reset(new TerrainLod());
+		}
+
+		//the two halves touch separate members of the surface
+		int mesh = graph.addTask(scene.name + " mesh", [this, &scene]()
+		{
+			loadSurface(*scene.surface, *scene.lod, scene.pathAltitude, scene.pathLava, scene.pathTemperature, scene.settings);
+		});
+		int texture = graph.addTask(scene.name + " texture", [&scene]()
+		{
+			scene.surface->decodeTexture(scene.pathTexture.c_str());
+		});
+		return graph.addTask(scene.name + " upload", [this, &scene]()
+		{
+			upload(*scene.surface);
+			scene.surface->allocateTexture();
+			scene.surface->uploadSlice(std::numeric_limits<size_t>::max());
+			makeResident(scene);
+		}, TASK_MAIN, {mesh, texture});
+	}
+
+	//Memory of the resident scenes, on the CPU and on the GPU
+	size_t getResidentBytes()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		return residentBytes();
+	}
+
+	//Memory of a scene on the CPU, 0 unless resident
+	size_t getCpuBytes(const int id)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		return scenes[id]->state == SCENE_RESIDENT ? scenes[id]->cpuBytes : 0;
+	}
+
+	//Memory of a scene on the GPU, 0 unless resident
+	size_t getGpuBytes(const int id)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		return scenes[id]->state == SCENE_RESIDENT ? scenes[id]->gpuBytes : 0;
+	}
+
+	size_t memoryBudget;
+	size_t uploadBytesPerFrame;
+
+	private:
+		std::string cacheDirectory;
+		void (*upload)(Surface&);
+		std::vector<std::unique_ptr<Scene> > scenes;
+		unsigned long long frame;
+
+		//shared with the loader thread
+		std::thread loader;
+		std::mutex mutex;
+		std::condition_variable wakeUp;
+		std::deque<int> queue;
+		bool stopping;
+
+		void makeResident(Scene& scene)
+		{
+			scene.surface->setResidency(scene.residency);
+			const size_t cpuBytes = scene.surface->getCpuBytes() + scene.lod->getCpuBytes();
+			const size_t gpuBytes = scene.surface->getGpuBytes();
+			std::cout << "Scene " << scene.name << " resident, " << cpuBytes / 1024 << " KB CPU, " << gpuBytes / 1024 << " KB GPU" << std::endl;
+			std::lock_guard<std::mutex> lock(mutex);
+			scene.cpuBytes = cpuBytes;
+			scene.gpuBytes = gpuBytes;
+			scene.state = SCENE_RESIDENT;
+		}
+
+		//Call it with the mutex locked
+		size_t residentBytes()
+		{
+			size_t bytes = 0;
+			for(unsigned int s=0; s<scenes.size(); s++)
+			{
+				if(scenes[s]->state == SCENE_RESIDENT)
+				{
+					bytes += scenes[s]->cpuBytes + scenes[s]->gpuBytes;
+				}
+			}
+			return bytes;
+		}
+
+		//Drops the least recently requested resident scenes until the others fit, never the one requested this frame
+		void evict()
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			size_t bytes = residentBytes();
+			while(bytes > memoryBudget)
+			{
+				Scene* oldest = NULL;
+				for(unsigned int s=0; s<scenes.size(); s++)
+				{
+					Scene* scene = scenes[s].get();
+					if(scene->state == SCENE_RESIDENT && scene->lastUsed + 1 < frame && (oldest == NULL || scene->lastUsed < oldest->lastUsed))
+					{
+						oldest = scene;
+					}
+				}
+				if(oldest == NULL)
+				{
+					return;
+				}
+
+				std::cout << "Scene " << oldest->name << " evicted, " << (oldest->cpuBytes + oldest->gpuBytes) / 1024 << " KB" << std::endl;
+				bytes -= oldest->cpuBytes + oldest->gpuBytes;
+				oldest->surface->releaseBuffers();
+				oldest->surface.reset();
+				oldest->lod.reset();
+				oldest->cpuBytes = 0;
+				oldest->gpuBytes = 0;
+				oldest->state = SCENE_UNLOADED;
+			}
+		}
+
+		void loadLoop()
+		{
+			Profiler::get().nameThread("scene loader");
+			std::unique_lock<std::mutex> lock(mutex);
+			while(!stopping)
+			{
+				if(queue.empty())
+				{
+					wakeUp.wait(lock);
+					continue;
+				}
+				Scene& scene = *scenes[queue.front()];
+				queue.pop_front();
+
+				//the scene cannot be touched by the render thread while it is loading
+				lock.unlock();
+				std::unique_ptr<Surface> surface(new Surface());
+				std::unique_ptr<TerrainLod> lod(new TerrainLod());
+				loadSurface(*surface, *lod, scene.pathAltitude, scene.pathLava, scene.pathTemperature, scene.settings);
+				surface->decodeTexture(scene.pathTexture.c_str());
+				lock.lock();
+
+				scene.surface.swap(surface);
+				scene.lod.swap(lod);
+				scene.state = SCENE_LOADED;
+			}
+		}
+
+		//Reads the surface and its levels of detail from the mesh cache, or builds them and saves them there
+		void loadSurface(Surface& surface, TerrainLod& lod, const std::string& pathAltitude, const std::string& pathLava, const std::string& pathTemperature, const SurfaceSettings& settings)
+		{
+			MeshCacheKey key;
+			key.addFile(pathAltitude);
+			key.addFile(pathLava);
+			key.addFile(pathTemperature);
+			Surface::addToCacheKey(key, settings);
+			TerrainLod::addToCacheKey(key);
+			std::string path = key.getPath(cacheDirectory);
+
+			{
+				ProfileScope scope("mesh cache read");
+				MeshCacheReader reader(path, key.getHash());
+				if(reader.isValid() && surface.readCache(reader) && lod.readCache(reader, surface))
+				{
+					return;
+				}
+			}
+
+			surface.build(pathAltitude, pathLava, pathTemperature, settings);
+			//the strips replace the triangle lists the coarse levels are appended to
+			if(!surface.hasStrips())
+			{
+				lod.build(surface);
+			}
+
+			ProfileScope scope("mesh cache write");
+			MeshCacheWriter writer(path, key.getHash());
+			surface.writeCache(writer);
+			lod.writeCache(writer);
+			writer.close();
+		}
+};
+
+#endif
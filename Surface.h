@@ -10,104 +10,807 @@
 
 #include "stb_image.h"
 #include "Matrix.h"
+#include "Frustum.h"
+#include "HiZ.h"
+#include "Rtin.h"
+#include "VertexCache.h"
+#include "MeshCache.h"
+#include "Profiler.h"
 #include <iostream>
 #include <vector>
 #include <random>
+#include <limits>
+#include <algorithm>
+#include <functional>
+
+//Side in cells of the square chunks the surface is split into
+const int CHUNK_SIZE = 64;
+
+//How the triangles of the surface are generated
+struct SurfaceSettings
+{
+	//Maximum vertical error in metres of the adaptive triangulation, 0 keeps two triangles per cell
+	float maxError;
+	//Keeps the cells covered by lava at full resolution in the adaptive triangulation
+	bool preserveLava;
+	//Reorders the triangles of every chunk for the vertex cache and the vertices for the vertex fetch
+	bool optimizeVertexCache;
+	//Draws the regular grid (maxError 0) as triangle strips with primitive restart, instead of triangle lists
+	bool triangleStrips;
+
+	SurfaceSettings():maxError(0.0f), preserveLava(true), optimizeVertexCache(true), triangleStrips(false)
+	{}
+};
+
+//Range of indicesEBO covering a block of cells, empty with triangle strips, with its bounding box in surface space
+struct SurfaceChunk
+{
+	int row;
+	int column;
+	unsigned int firstIndex;
+	unsigned int indexCount;
+	glm::vec3 minBound;
+	glm::vec3 maxBound;
+	//triangle strip of the chunk, in stripIndicesShort relative to stripBaseVertex or else in stripIndicesWide
+	unsigned int stripFirstIndex;
+	unsigned int stripIndexCount;
+	int stripBaseVertex;
+	bool stripShortIndices;
+};
+
+//Restart index of the triangle strips, the biggest value of the index type
+const unsigned short STRIP_RESTART_SHORT = 0xFFFF;
+const unsigned int STRIP_RESTART_WIDE = 0xFFFFFFFF;
+
+//What a surface keeps in CPU memory once its vertex arrays and texture are on the GPU
+enum SurfaceResidency
+{
+	//everything, as LavaOverlay and writeCache need
+	RESIDENCY_KEEP,
+	//the three grids, for heights, holes and temperatures, but not the vertices and indices
+	RESIDENCY_DROP_GEOMETRY,
+	//only the chunks and the sizes needed to cull and draw
+	RESIDENCY_METADATA
+};
+
+//Arguments of a glMultiDrawElementsBaseVertex call, with the place of every draw in the front to back order of the
+//lists built together
+struct DrawList
+{
+	std::vector<GLsizei> counts;
+	std::vector<const void*> offsets;
+	std::vector<GLint> baseVertices;
+	std::vector<unsigned int> ranks;
+
+	void clear()
+	{
+		counts.clear();
+		offsets.clear();
+		baseVertices.clear();
+		ranks.clear();
+	}
+
+	//Draws among the nearest maxDraws of all the lists
+	unsigned int countNearest(const unsigned int maxDraws) const
+	{
+		return std::lower_bound(ranks.begin(), ranks.end(), maxDraws) - ranks.begin();
+	}
+};
+
+//Corner on the border of a block of Surface::triangulateTiles: its row and column in the block, its error shared with
+//the blocks around and the block across the border, -1 at the border of the grid
+struct BorderCorner
+{
+	int row;
+	int column;
+	float* error;
+	int neighbour;
+
+	BorderCorner(const int row, const int column, float* error, const int neighbour):row(row), column(column), error(error), neighbour(neighbour)
+	{}
+};
 
 class Surface
 {
 	public:
-	Surface(const std::string& pathAltitude):altitude(pathAltitude), numberOfAttributes(4),currentRowIndices(NULL), lastRowIndices(NULL),texture(0)
+	Surface(const std::string& pathAltitude, const SurfaceSettings& settings = SurfaceSettings()):altitude(pathAltitude), settings(settings), numberOfAttributes(4),currentRowIndices(NULL), lastRowIndices(NULL),texture(0), stripVAO(0), VAO(0), textureData(NULL), uploadedBytes(0), gpuBytes(0), residency(RESIDENCY_KEEP)
+	{
+		loadVertexAndIndex();
+	}
+	Surface(const std::string& pathAltitude, const std::string& pathLava, const std::string& pathTemperature, const SurfaceSettings& settings = SurfaceSettings()):altitude(pathAltitude), lava(pathLava), temperature(pathTemperature), settings(settings), numberOfAttributes(4),currentRowIndices(NULL), lastRowIndices(NULL), texture(0), stripVAO(0), VAO(0), textureData(NULL), uploadedBytes(0), gpuBytes(0), residency(RESIDENCY_KEEP)
 	{
 		loadVertexAndIndex();
 	}
-	Surface(const std::string& pathAltitude, const std::string& pathLava, const std::string& pathTemperature):altitude(pathAltitude), lava(pathLava), temperature(pathTemperature), numberOfAttributes(4),currentRowIndices(NULL), lastRowIndices(NULL), texture(0)
+	//Empty surface, to be filled by build or readCache
+	Surface():numberOfAttributes(4), currentRowIndices(NULL), lastRowIndices(NULL), texture(0), stripVAO(0), VAO(0), textureData(NULL), uploadedBytes(0), gpuBytes(0), residency(RESIDENCY_KEEP)
+	{}
+
+	~Surface()
+	{
+		freeTexture();
+		delete [] currentRowIndices;
+		delete [] lastRowIndices;
+	}
+
+	//Meshes the grids of an empty surface, as the constructors do. An empty path leaves that grid out
+	void build(const std::string& pathAltitude, const std::string& pathLava, const std::string& pathTemperature, const SurfaceSettings& surfaceSettings)
 	{
+		clear();
+		ProfileScope readScope("grids read");
+		altitude.loadFile(pathAltitude);
+		lava.loadFile(pathLava);
+		temperature.loadFile(pathTemperature);
+		readScope.end();
+		settings = surfaceSettings;
+		ProfileScope meshScope("meshing");
 		loadVertexAndIndex();
 	}
 
+	//Adds to key the settings that change the mesh
+	static void addToCacheKey(MeshCacheKey& key, const SurfaceSettings& surfaceSettings)
+	{
+		key.add(surfaceSettings.maxError);
+		key.add(surfaceSettings.preserveLava);
+		key.add(surfaceSettings.optimizeVertexCache);
+		key.add(surfaceSettings.triangleStrips);
+		key.add(CHUNK_SIZE);
+		key.add(VERTEX_CACHE_SIZE);
+		key.add(RTIN_VERSION);
+	}
+
+	//Writes the grids and every table built from them
+	void writeCache(MeshCacheWriter& writer)
+	{
+		writeMatrix(writer, altitude);
+		writeMatrix(writer, lava);
+		writeMatrix(writer, temperature);
+		writer.write(settings);
+		writer.writeVector(vertices);
+		writer.writeVector(indicesEBO);
+		writer.writeVector(chunks);
+		writer.writeVector(stripIndicesShort);
+		writer.writeVector(stripIndicesWide);
+		writer.writeVector(cornerIndices);
+	}
+
+	//Fills an empty surface from a cache entry, copying every table in one go. Returns false if the entry is broken
+	bool readCache(MeshCacheReader& reader)
+	{
+		bool read = readMatrix(reader, altitude) && readMatrix(reader, lava) && readMatrix(reader, temperature)
+			&& reader.read(settings) && reader.readVector(vertices) && reader.readVector(indicesEBO) && reader.readVector(chunks)
+			&& reader.readVector(stripIndicesShort) && reader.readVector(stripIndicesWide) && reader.readVector(cornerIndices);
+		if(!read)
+		{
+			clear();
+			return false;
+		}
+
+		chunkBoxes.clear();
+		for(unsigned int c=0; c<chunks.size(); c++)
+		{
+			chunkBoxes.addBox(chunks[c].minBound, chunks[c].maxBound);
+		}
+		return true;
+	}
+
 	float getMaxHeight()
 	{
-		return altitude.getMaxValue();
+		return residency == RESIDENCY_METADATA ? summary.maxHeight : altitude.getMaxValue();
 	}
 
 	float getMinHeight()
 	{
-		return altitude.getMinValue();
+		return residency == RESIDENCY_METADATA ? summary.minHeight : altitude.getMinValue();
 	}
 
 	float getDropHeight()
 	{
-		return altitude.getMaxValue() - altitude.getMinValue();
+		return getMaxHeight() - getMinHeight();
 	}
 
 	unsigned int getRows()
 	{
-		return altitude.getRows();
+		return residency == RESIDENCY_METADATA ? summary.rows : altitude.getRows();
 	}
 
 	unsigned int getColumns()
 	{
-		return altitude.getColumns();
+		return residency == RESIDENCY_METADATA ? summary.columns : altitude.getColumns();
 	}
 
 	float getCellSize()
 	{
-		return altitude.getCellSize();
+		return residency == RESIDENCY_METADATA ? summary.cellSize : altitude.getCellSize();
+	}
+
+	//Number of indices in the index buffer of VAO, to draw it whole
+	unsigned int getIndexCount()
+	{
+		return residency == RESIDENCY_KEEP ? indicesEBO.size() : summary.indexCount;
+	}
+
+	bool isHoleCell(const int i, const int j)
+	{
+		return altitude.isHoleCell(i, j);
+	}
+
+	//Index of the vertex at the corner between cells, or -1 if no cell around it has been meshed
+	int getCornerIndex(const int row, const int column)
+	{
+		return cornerIndices[row * (altitude.getColumns() + 1) + column];
+	}
+
+	//Temperatures mapped to 0 and 1 by the shader, (0, 1) without temperatures
+	glm::vec2 getTemperatureRange()
+	{
+		if(residency == RESIDENCY_METADATA)
+		{
+			return summary.temperatureRange;
+		}
+		if(!temperature.isLoaded())
+		{
+			return glm::vec2(0.0f, 1.0f);
+		}
+		return glm::vec2(temperature.getMinValue(), temperature.getMaxValue());
+	}
+
+	unsigned int getNumberOfAttributes()
+	{
+		return numberOfAttributes;
+	}
+
+	const SurfaceSettings& getSettings()
+	{
+		return settings;
+	}
+
+	//Sets the corner heights of the vertices and forces the holes, and the lava cells if preserved, for an adaptive
+	//triangulation of the block of blockRows x blockColumns cells from firstRow, firstColumn. The cells around the block
+	//force its border corners as they would in the whole grid. Needs RESIDENCY_KEEP
+	void fillRtin(Rtin& rtin, const int firstRow, const int firstColumn, const int blockRows, const int blockColumns)
+	{
+		for(int i=0; i<=blockRows; i++)
+		{
+			for(int j=0; j<=blockColumns; j++)
+			{
+				int index = getCornerIndex(firstRow + i, firstColumn + j);
+				if(index != -1)
+				{
+					rtin.setHeight(i, j, vertices[index * numberOfAttributes].y);
+				}
+			}
+		}
+		const int lastRow = std::min(firstRow + blockRows + 1, altitude.getRows());
+		const int lastColumn = std::min(firstColumn + blockColumns + 1, altitude.getColumns());
+		for(int i=std::max(firstRow - 1, 0); i<lastRow; i++)
+		{
+			for(int j=std::max(firstColumn - 1, 0); j<lastColumn; j++)
+			{
+				bool lavaCell = settings.preserveLava && lava.isLoaded() && lava.getValue(i, j) > 0.0f;
+				if(altitude.isHoleCell(i, j) || lavaCell)
+				{
+					rtin.forceCell(i - firstRow, j - firstColumn);
+				}
+			}
+		}
+	}
+
+	//Triangulates the grid within maxError one block of tileSize cells per side at a time, a power of two, so that only
+	//one block is held at once. visit gets the row and column of every block, and its triangles in block coordinates as
+	//Rtin::triangulate makes them. The error of a corner on a border depends on the blocks on both sides, and through the
+	//corners of the blocks on the borders further away: the blocks exchange the errors of their border corners until
+	//none grows, then are triangulated with them, for both sides of a border to split it alike. Needs RESIDENCY_KEEP
+	void triangulateTiles(const int tileSize, const float maxError, const std::function<void(int, int, Rtin&, std::vector<int>&)>& visit)
+	{
+		const int rowsCount = altitude.getRows();
+		const int columnsCount = altitude.getColumns();
+		const int tileRows = (rowsCount + tileSize - 1) / tileSize;
+		const int tileColumns = (columnsCount + tileSize - 1) / tileSize;
+
+		//errors of the corners on the rows of corners tileSize apart, then on the columns
+		std::vector<float> rowBorders((size_t)(tileRows + 1) * (columnsCount + 1), 0.0f);
+		std::vector<float> columnBorders((size_t)(tileColumns + 1) * (rowsCount + 1), 0.0f);
+		//blocks to compute again, because an error on their borders grew since they were
+		std::vector<char> stale((size_t)tileRows * tileColumns, 1);
+		std::vector<int> triangles;
+		bool grown = true;
+		for(bool triangulating=false; ; triangulating=!grown)
+		{
+			grown = false;
+			for(int r=0; r<tileRows; r++)
+			{
+				for(int c=0; c<tileColumns; c++)
+				{
+					if(!triangulating && !stale[r * tileColumns + c])
+					{
+						continue;
+					}
+					stale[r * tileColumns + c] = 0;
+					const int firstRow = r * tileSize;
+					const int firstColumn = c * tileSize;
+					const int blockRows = std::min(tileSize, rowsCount - firstRow);
+					const int blockColumns = std::min(tileSize, columnsCount - firstColumn);
+					Rtin rtin(blockRows, blockColumns);
+					fillRtin(rtin, firstRow, firstColumn, blockRows, blockColumns);
+
+					//the corners of the top, bottom, left and right borders, with the block on the other side
+					std::vector<BorderCorner> corners;
+					for(int k=0; k<=blockColumns; k++)
+					{
+						corners.push_back(BorderCorner(0, k, &rowBorders[(size_t)r * (columnsCount + 1) + firstColumn + k], r > 0 ? (r - 1) * tileColumns + c : -1));
+						corners.push_back(BorderCorner(blockRows, k, &rowBorders[(size_t)(r + 1) * (columnsCount + 1) + firstColumn + k], r + 1 < tileRows ? (r + 1) * tileColumns + c : -1));
+					}
+					for(int k=0; k<=blockRows; k++)
+					{
+						corners.push_back(BorderCorner(k, 0, &columnBorders[(size_t)c * (rowsCount + 1) + firstRow + k], c > 0 ? r * tileColumns + c - 1 : -1));
+						corners.push_back(BorderCorner(k, blockColumns, &columnBorders[(size_t)(c + 1) * (rowsCount + 1) + firstRow + k], c + 1 < tileColumns ? r * tileColumns + c + 1 : -1));
+					}
+
+					for(unsigned int k=0; k<corners.size(); k++)
+					{
+						rtin.seedError(corners[k].row, corners[k].column, *corners[k].error);
+					}
+					if(triangulating)
+					{
+						triangles.clear();
+						rtin.triangulate(maxError, triangles);
+						visit(r, c, rtin, triangles);
+						continue;
+					}
+					for(unsigned int k=0; k<corners.size(); k++)
+					{
+						float error = rtin.getVertexError(corners[k].row, corners[k].column);
+						if(error > *corners[k].error)
+						{
+							*corners[k].error = error;
+							if(corners[k].neighbour != -1)
+							{
+								stale[corners[k].neighbour] = 1;
+								grown = true;
+							}
+						}
+					}
+				}
+			}
+			if(triangulating)
+			{
+				break;
+			}
+		}
 	}
 
 	void loadTexture(char const * path)
 	{
-	    glGenTextures(1, &texture);
+	    decodeTexture(path);
+	    uploadTexture();
+	}
 
-	    int width, height, nrComponents;
-	    unsigned char *data = stbi_load(path, &width, &height, &nrComponents, 0);
-	    if (data)
+	//First half of loadTexture, without GL calls so that it can run on another thread. The mipmaps are filtered here
+	//rather than by glGenerateMipmap, so that the render thread only has to copy them
+	void decodeTexture(char const * path)
+	{
+	    ProfileScope scope("texture decode");
+	    freeTexture();
+	    textureData = stbi_load(path, &textureWidth, &textureHeight, &textureComponents, 0);
+	    if (!textureData)
 	    {
-	        GLenum format;
-	        if (nrComponents == 1)
-	            format = GL_RED;
-	        else if (nrComponents == 3)
-	            format = GL_RGB;
-	        else if (nrComponents == 4)
-	            format = GL_RGBA;
+	        std::cout << "Texture failed to load at path: " << path << std::endl;
+	        return;
+	    }
+	    while (levelWidth(textureMipmaps.size()) > 1 || levelHeight(textureMipmaps.size()) > 1)
+	        buildMipmap(textureMipmaps.size() + 1);
+	}
+
+	//Second half of loadTexture, with the GL context current
+	void uploadTexture()
+	{
+	    allocateTexture();
+	    size_t position = 0;
+	    size_t budget = std::numeric_limits<size_t>::max();
+	    uploadTextureSlice(position, budget);
+	    gpuBytes += position;
+	    freeTexture();
+	}
+
+	//Creates the texture and its mipmaps without their pixels, sent by uploadTexture or uploadSlice
+	void allocateTexture()
+	{
+	    glGenTextures(1, &texture);
+	    uploadedBytes = 0;
 
+	    if (textureData)
+	    {
+	        GLenum format = textureFormat();
 	        glBindTexture(GL_TEXTURE_2D, texture);
-	        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-	        glGenerateMipmap(GL_TEXTURE_2D);
+	        for (int level = 0; level <= (int)textureMipmaps.size(); level++)
+	            glTexImage2D(GL_TEXTURE_2D, level, format, levelWidth(level), levelHeight(level), 0, format, GL_UNSIGNED_BYTE, NULL);
 
+	        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, textureMipmaps.size());
 	        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
 	        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
 	        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
 	        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-	        stbi_image_free(data);
 	    }
-	    else
+	}
+
+	//Fills the buffers of the vertex arrays, created empty, and the texture from allocateTexture, copying at most maxBytes
+	//(or one row of the texture) per call so that a big surface reaches the GPU over several frames. True once all is there
+	bool uploadSlice(const size_t maxBytes)
+	{
+		GLint vertexBuffer = 0;
+		GLint elementBuffer = 0;
+		GLint stripBuffer = 0;
+		glBindVertexArray(VAO);
+		glGetVertexAttribiv(0, GL_VERTEX_ATTRIB_ARRAY_BUFFER_BINDING, &vertexBuffer);
+		glGetIntegerv(GL_ELEMENT_ARRAY_BUFFER_BINDING, &elementBuffer);
+		if(stripVAO != 0)
+		{
+			glBindVertexArray(stripVAO);
+			glGetIntegerv(GL_ELEMENT_ARRAY_BUFFER_BINDING, &stripBuffer);
+		}
+		glBindVertexArray(0);
+
+		//the tables are sent one after the other, position is where the next one starts in that sequence
+		size_t budget = maxBytes;
+		size_t position = 0;
+		uploadBufferSlice(vertexBuffer, 0, vertices.data(), vertices.size() * sizeof(glm::vec3), position, budget);
+		uploadBufferSlice(elementBuffer, 0, indicesEBO.data(), indicesEBO.size() * sizeof(unsigned int), position, budget);
+		if(stripVAO != 0)
+		{
+			//wide indices first, as laid out by loadStripVAO
+			const size_t wideBytes = stripIndicesWide.size() * sizeof(unsigned int);
+			uploadBufferSlice(stripBuffer, 0, stripIndicesWide.data(), wideBytes, position, budget);
+			uploadBufferSlice(stripBuffer, wideBytes, stripIndicesShort.data(), stripIndicesShort.size() * sizeof(unsigned short), position, budget);
+		}
+		uploadTextureSlice(position, budget);
+
+		if(uploadedBytes < position)
+		{
+			return false;
+		}
+		gpuBytes = position;
+		freeTexture();
+		return true;
+	}
+
+	//Frees the CPU copies the mode does not keep, once uploadSlice has sent them. The getters keep working in every mode,
+	//LavaOverlay, writeCache, isHoleCell and getCornerIndex need RESIDENCY_KEEP
+	void setResidency(const SurfaceResidency mode)
+	{
+		if(mode == RESIDENCY_KEEP || mode <= residency)
+		{
+			return;
+		}
+		summary.rows = getRows();
+		summary.columns = getColumns();
+		summary.cellSize = getCellSize();
+		summary.minHeight = getMinHeight();
+		summary.maxHeight = getMaxHeight();
+		summary.temperatureRange = getTemperatureRange();
+		summary.indexCount = getIndexCount();
+		summary.strips = hasStrips();
+		summary.stripWideCount = stripWideCount();
+
+		std::vector<glm::vec3>().swap(vertices);
+		std::vector<unsigned int>().swap(indicesEBO);
+		std::vector<unsigned short>().swap(stripIndicesShort);
+		std::vector<unsigned int>().swap(stripIndicesWide);
+		std::vector<int>().swap(cornerIndices);
+		if(mode == RESIDENCY_METADATA)
+		{
+			altitude.clear();
+			lava.clear();
+			temperature.clear();
+		}
+		residency = mode;
+	}
+
+	SurfaceResidency getResidency()
+	{
+		return residency;
+	}
+
+	//Memory held on the CPU by the tables, the grids and a texture waiting for its upload
+	size_t getCpuBytes()
+	{
+		size_t bytes = vectorBytes(vertices) + vectorBytes(indicesEBO) + vectorBytes(chunks) + vectorBytes(stripIndicesShort)
+			+ vectorBytes(stripIndicesWide) + vectorBytes(visibleChunks) + vectorBytes(chunkDistances) + vectorBytes(cornerIndices)
+			+ 6 * vectorBytes(chunkBoxes.centerX)
+			+ altitude.getBytes() + lava.getBytes() + temperature.getBytes();
+		if(textureData)
+		{
+			bytes += textureWidth * textureHeight * textureComponents;
+			for(unsigned int m=0; m<textureMipmaps.size(); m++)
+			{
+				bytes += vectorBytes(textureMipmaps[m]);
+			}
+		}
+		return bytes;
+	}
+
+	//Memory of the buffers and of the texture with its mipmaps on the GPU, as sent by uploadSlice
+	size_t getGpuBytes()
+	{
+		return gpuBytes;
+	}
+
+	//Deletes the vertex arrays, their buffers and the texture. Call it with the GL context current
+	void releaseBuffers()
+	{
+	    unsigned int vertexArrays[2] = {VAO, stripVAO};
+	    for (int k = 0; k < 2; k++)
 	    {
-	        std::cout << "Texture failed to load at path: " << path << std::endl;
-	        stbi_image_free(data);
+	        if (vertexArrays[k] == 0)
+	            continue;
+
+	        GLint vertexBuffer = 0;
+	        GLint elementBuffer = 0;
+	        glBindVertexArray(vertexArrays[k]);
+	        glGetVertexAttribiv(0, GL_VERTEX_ATTRIB_ARRAY_BUFFER_BINDING, &vertexBuffer);
+	        glGetIntegerv(GL_ELEMENT_ARRAY_BUFFER_BINDING, &elementBuffer);
+	        glBindVertexArray(0);
+
+	        //the strip vertex array shares the vertex buffer of the other one
+	        unsigned int buffers[2] = {(unsigned int)elementBuffer, k == 0 ? (unsigned int)vertexBuffer : 0u};
+	        glDeleteBuffers(2, buffers);
+	        glDeleteVertexArrays(1, &vertexArrays[k]);
 	    }
+	    glDeleteTextures(1, &texture);
+	    VAO = 0;
+	    stripVAO = 0;
+	    texture = 0;
+	}
+		
+	//Fills counts and offsets with the chunks inside the frustum, nearest to the viewer first, ready for glMultiDrawElements.
+	//Chunks the occlusion culler, if any, finds hidden are left out. Returns the number of indices to draw
+	unsigned int buildDrawList(const Frustum& frustum, const glm::vec3& viewPosition, std::vector<GLsizei>& counts, std::vector<const void*>& offsets, HiZCuller* occlusion = NULL)
+	{
+		frustum.cullBoxes(chunkBoxes, visibleChunks);
+		sortVisibleChunks(viewPosition);
+		cullOccludedChunks(occlusion);
+
+		counts.clear();
+		offsets.clear();
+		unsigned int drawnIndices = 0;
+		for(unsigned int i=0; i<visibleChunks.size(); i++)
+		{
+			const SurfaceChunk& chunk = chunks[visibleChunks[i]];
+			counts.push_back(chunk.indexCount);
+			offsets.push_back((const void*)(chunk.firstIndex * sizeof(unsigned int)));
+			drawnIndices += chunk.indexCount;
+		}
+		return drawnIndices;
 	}
 		
+	bool hasStrips()
+	{
+		if(residency != RESIDENCY_KEEP)
+		{
+			return summary.strips;
+		}
+		return !stripIndicesShort.empty() || !stripIndicesWide.empty();
+	}
+
+	//Same as buildDrawList for the triangle strips: the strip index buffer holds the wide indices first, then the short ones
+	unsigned int buildStripDrawList(const Frustum& frustum, const glm::vec3& viewPosition, DrawList& shortDraws, DrawList& wideDraws, HiZCuller* occlusion = NULL)
+	{
+		frustum.cullBoxes(chunkBoxes, visibleChunks);
+		sortVisibleChunks(viewPosition);
+		cullOccludedChunks(occlusion);
+
+		shortDraws.clear();
+		wideDraws.clear();
+		unsigned int drawnIndices = 0;
+		unsigned int rank = 0;
+		for(unsigned int i=0; i<visibleChunks.size(); i++)
+		{
+			const SurfaceChunk& chunk = chunks[visibleChunks[i]];
+			if(chunk.stripIndexCount == 0)
+			{
+				continue;
+			}
+
+			if(chunk.stripShortIndices)
+			{
+				shortDraws.counts.push_back(chunk.stripIndexCount);
+				shortDraws.offsets.push_back((const void*)(stripWideCount() * sizeof(unsigned int) + chunk.stripFirstIndex * sizeof(unsigned short)));
+				shortDraws.baseVertices.push_back(chunk.stripBaseVertex);
+				shortDraws.ranks.push_back(rank++);
+			}
+			else
+			{
+				wideDraws.counts.push_back(chunk.stripIndexCount);
+				wideDraws.offsets.push_back((const void*)(chunk.stripFirstIndex * sizeof(unsigned int)));
+				wideDraws.baseVertices.push_back(0);
+				wideDraws.ranks.push_back(rank++);
+			}
+			drawnIndices += chunk.stripIndexCount;
+		}
+		return drawnIndices;
+	}
+
 	std::vector<glm::vec3> vertices;
 	std::vector<unsigned int> indicesEBO;
+	std::vector<SurfaceChunk> chunks;
+	BoxList chunkBoxes;
+	std::vector<unsigned short> stripIndicesShort;
+	std::vector<unsigned int> stripIndicesWide;
+	unsigned int stripVAO;
 	unsigned int texture;
 	unsigned int VAO;
 	private:
 		Matrix altitude;
 		Matrix lava;
 		Matrix temperature;
+		SurfaceSettings settings;
 
 		int* currentRowIndices;
 		int* lastRowIndices;
 
+		//pixels decoded by decodeTexture, waiting for uploadTexture, and the levels after the first
+		unsigned char* textureData;
+		std::vector<std::vector<unsigned char> > textureMipmaps;
+		int textureWidth;
+		int textureHeight;
+		int textureComponents;
+		//bytes already sent by uploadSlice, and in total once it is done
+		size_t uploadedBytes;
+		size_t gpuBytes;
+
+		//what getters need once setResidency dropped the tables and grids they read
+		struct
+		{
+			unsigned int rows;
+			unsigned int columns;
+			float cellSize;
+			float minHeight;
+			float maxHeight;
+			glm::vec2 temperatureRange;
+			unsigned int indexCount;
+			bool strips;
+			unsigned int stripWideCount;
+		} summary;
+		SurfaceResidency residency;
+
+		template <typename T>
+		static size_t vectorBytes(const std::vector<T>& values)
+		{
+			return values.capacity() * sizeof(T);
+		}
+
+		unsigned int stripWideCount()
+		{
+			return residency == RESIDENCY_KEEP ? stripIndicesWide.size() : summary.stripWideCount;
+		}
+
+		GLenum textureFormat()
+		{
+			if (textureComponents == 1)
+				return GL_RED;
+			else if (textureComponents == 3)
+				return GL_RGB;
+			return GL_RGBA;
+		}
+
+		int levelWidth(const int level)
+		{
+			return std::max(1, textureWidth >> level);
+		}
+
+		int levelHeight(const int level)
+		{
+			return std::max(1, textureHeight >> level);
+		}
+
+		const unsigned char* levelData(const int level)
+		{
+			return level == 0 ? textureData : &textureMipmaps[level - 1][0];
+		}
+
+		//Averages the 2x2 blocks of the level before, repeating its last row or column when it is odd
+		void buildMipmap(const int level)
+		{
+			const int sourceWidth = levelWidth(level - 1);
+			const int sourceHeight = levelHeight(level - 1);
+			const unsigned char* source = levelData(level - 1);
+			const int width = levelWidth(level);
+			const int height = levelHeight(level);
+			std::vector<unsigned char> pixels(width * height * textureComponents);
+			for(int y=0; y<height; y++)
+			{
+				for(int x=0; x<width; x++)
+				{
+					const int top = std::min(2 * y, sourceHeight - 1) * sourceWidth;
+					const int bottom = std::min(2 * y + 1, sourceHeight - 1) * sourceWidth;
+					const int left = std::min(2 * x, sourceWidth - 1);
+					const int right = std::min(2 * x + 1, sourceWidth - 1);
+					for(int k=0; k<textureComponents; k++)
+					{
+						const int sum = source[(top + left) * textureComponents + k] + source[(top + right) * textureComponents + k]
+							+ source[(bottom + left) * textureComponents + k] + source[(bottom + right) * textureComponents + k];
+						pixels[(y * width + x) * textureComponents + k] = (sum + 2) / 4;
+					}
+				}
+			}
+			textureMipmaps.push_back(pixels);
+		}
+
+		void freeTexture()
+		{
+			stbi_image_free(textureData);
+			textureData = NULL;
+			std::vector<std::vector<unsigned char> >().swap(textureMipmaps);
+		}
+
+		//Sends the rows of the texture levels, one after the other from position, that are not on the GPU yet and fit in budget
+		void uploadTextureSlice(size_t& position, size_t& budget)
+		{
+			if(!textureData)
+			{
+				return;
+			}
+			glBindTexture(GL_TEXTURE_2D, texture);
+			glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+			for(int level=0; level<=(int)textureMipmaps.size(); level++)
+			{
+				const size_t rowBytes = levelWidth(level) * textureComponents;
+				const int height = levelHeight(level);
+				if(budget > 0 && uploadedBytes < position + rowBytes * height)
+				{
+					const int firstRow = (uploadedBytes - position) / rowBytes;
+					const int rowsCount = std::min<size_t>(std::max<size_t>(budget / rowBytes, 1), height - firstRow);
+					glTexSubImage2D(GL_TEXTURE_2D, level, 0, firstRow, levelWidth(level), rowsCount, textureFormat(), GL_UNSIGNED_BYTE, levelData(level) + firstRow * rowBytes);
+					uploadedBytes += rowsCount * rowBytes;
+					//the rest of a budget smaller than a row waits for the next slice
+					budget = firstRow + rowsCount < height ? 0 : budget - std::min(budget, rowsCount * rowBytes);
+				}
+				position += rowBytes * height;
+			}
+			glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+		}
+
+		//Sends the part of a table of size bytes, at position in the sequence of uploadSlice, that is not on the GPU yet and fits in budget
+		void uploadBufferSlice(const GLint buffer, const size_t bufferOffset, const void* data, const size_t size, size_t& position, size_t& budget)
+		{
+			if(budget > 0 && uploadedBytes < position + size)
+			{
+				const size_t begin = uploadedBytes - position;
+				const size_t count = std::min(size - begin, budget);
+				glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+				glBufferSubData(GL_COPY_WRITE_BUFFER, bufferOffset + begin, count, (const char*)data + begin);
+				uploadedBytes += count;
+				budget -= count;
+			}
+			position += size;
+		}
+
 		unsigned int numberOfAttributes;
+		std::vector<unsigned int> visibleChunks;
+		//squared distance of every visible chunk from the viewer, by chunk index
+		std::vector<float> chunkDistances;
+		std::vector<int> cornerIndices;
 		
 		void loadVertexAndIndex()
 		{
 			inizializeIndexRow();
 
+			const int chunkColumns = (altitude.getColumns() + CHUNK_SIZE - 1) / CHUNK_SIZE;
+			const int chunkRows = (altitude.getRows() + CHUNK_SIZE - 1) / CHUNK_SIZE;
+			std::vector<std::vector<unsigned int> > chunkIndices(chunkRows * chunkColumns);
+			chunks.resize(chunkRows * chunkColumns);
+			for(unsigned int c=0; c<chunks.size(); c++)
+			{
+				chunks[c].row = c / chunkColumns;
+				chunks[c].column = c % chunkColumns;
+				chunks[c].stripFirstIndex = 0;
+				chunks[c].stripIndexCount = 0;
+				chunks[c].stripBaseVertex = 0;
+				chunks[c].stripShortIndices = true;
+				chunks[c].minBound = glm::vec3(std::numeric_limits<float>::max());
+				chunks[c].maxBound = glm::vec3(-std::numeric_limits<float>::max());
+			}
+			cornerIndices.assign((altitude.getRows() + 1) * (altitude.getColumns() + 1), -1);
+
 			for(int i=0; i<altitude.getRows(); i++)
 			{
 				for(int j=0; j<altitude.getColumns(); j++)
@@ -197,13 +900,18 @@ class Surface
 					currentIndex++;
 					currentRowIndices[j + 1] = bottomRightIndex;
 
+					setCornerIndex(i, j, topLeftIndex);
+					setCornerIndex(i + 1, j, bottomLeftIndex);
+					setCornerIndex(i, j + 1, topRightIndex);
+					setCornerIndex(i + 1, j + 1, bottomRightIndex);
+
 					glm::vec3 normal = generateNormal(bottomLeftVertex - topLeftVertex, topRightVertex - topLeftVertex);
 
-					//Redvalue
+					//Redvalue: the raw temperature, normalized by the shader over getTemperatureRange
 					glm::vec3 redColor;
 					if(temperature.isLoaded())
 					{
-						redColor = glm::vec3(computeRedValue(i, j), 0.0f, 0.0f);
+						redColor = glm::vec3(temperature.getValue(i, j), 0.0f, 0.0f);
 					}
 
 					//add vertices and attributes
@@ -229,15 +937,23 @@ class Surface
 					glm::vec3 texCoord = computeTexCoord(bottomRightVertex);
 					addVertex(bottomRightVertex, normal, redColor, texCoord);
 
+					const int chunk = (i / CHUNK_SIZE) * chunkColumns + j / CHUNK_SIZE;
+					std::vector<unsigned int>& cellIndices = chunkIndices[chunk];
+
 					//generate first triangle
-					indicesEBO.push_back(topLeftIndex);
-					indicesEBO.push_back(bottomLeftIndex);
-					indicesEBO.push_back(topRightIndex);
+					cellIndices.push_back(topLeftIndex);
+					cellIndices.push_back(bottomLeftIndex);
+					cellIndices.push_back(topRightIndex);
 
 					//generate second triangle
-					indicesEBO.push_back(bottomLeftIndex);
-					indicesEBO.push_back(topRightIndex);
-					indicesEBO.push_back(bottomRightIndex);
+					cellIndices.push_back(bottomLeftIndex);
+					cellIndices.push_back(topRightIndex);
+					cellIndices.push_back(bottomRightIndex);
+
+					growBounds(chunks[chunk], topLeftVertex);
+					growBounds(chunks[chunk], bottomLeftVertex);
+					growBounds(chunks[chunk], topRightVertex);
+					growBounds(chunks[chunk], bottomRightVertex);
 				}
 
 				//swap current and last row pointers
@@ -245,10 +961,334 @@ class Surface
 				currentRowIndices=lastRowIndices;
 				lastRowIndices=tmp;
 			}
+
+			if(settings.maxError > 0.0f)
+			{
+				triangulateAdaptive(chunkIndices);
+			}
+
+			buildChunks(chunkIndices);
+
+			if(settings.optimizeVertexCache)
+			{
+				optimizeVertexCache();
+			}
+
+			if(settings.triangleStrips)
+			{
+				if(settings.maxError > 0.0f)
+				{
+					std::cout << "Triangle strips need the regular grid, ignored with an adaptive triangulation" << std::endl;
+				}
+				else
+				{
+					buildStrips();
+				}
+			}
+		}
+
+		//One strip per row of cells in every chunk, restarted at the holes
+		void buildStrips()
+		{
+			std::vector<unsigned int> strip;
+			for(unsigned int c=0; c<chunks.size(); c++)
+			{
+				SurfaceChunk& chunk = chunks[c];
+				const int firstRow = chunk.row * CHUNK_SIZE;
+				const int firstColumn = chunk.column * CHUNK_SIZE;
+				const int lastRow = std::min(altitude.getRows(), firstRow + CHUNK_SIZE);
+				const int lastColumn = std::min(altitude.getColumns(), firstColumn + CHUNK_SIZE);
+
+				strip.clear();
+				for(int i=firstRow; i<lastRow; i++)
+				{
+					bool open = false;
+					for(int j=firstColumn; j<lastColumn; j++)
+					{
+						if(altitude.isHoleCell(i, j))
+						{
+							if(open)
+							{
+								strip.push_back(STRIP_RESTART_WIDE);
+								open = false;
+							}
+							continue;
+						}
+
+						if(!open)
+						{
+							strip.push_back(getCornerIndex(i, j));
+							strip.push_back(getCornerIndex(i + 1, j));
+							open = true;
+						}
+						strip.push_back(getCornerIndex(i, j + 1));
+						strip.push_back(getCornerIndex(i + 1, j + 1));
+					}
+					if(open)
+					{
+						strip.push_back(STRIP_RESTART_WIDE);
+					}
+				}
+				if(!strip.empty())
+				{
+					strip.pop_back();
+				}
+
+				unsigned int minIndex = STRIP_RESTART_WIDE;
+				unsigned int maxIndex = 0;
+				for(unsigned int k=0; k<strip.size(); k++)
+				{
+					if(strip[k] != STRIP_RESTART_WIDE)
+					{
+						minIndex = std::min(minIndex, strip[k]);
+						maxIndex = std::max(maxIndex, strip[k]);
+					}
+				}
+
+				chunk.stripIndexCount = strip.size();
+				chunk.stripShortIndices = strip.empty() || maxIndex - minIndex < STRIP_RESTART_SHORT;
+				chunk.stripBaseVertex = chunk.stripShortIndices && !strip.empty() ? minIndex : 0;
+				if(chunk.stripShortIndices)
+				{
+					chunk.stripFirstIndex = stripIndicesShort.size();
+					for(unsigned int k=0; k<strip.size(); k++)
+					{
+						stripIndicesShort.push_back(strip[k] == STRIP_RESTART_WIDE ? STRIP_RESTART_SHORT : (unsigned short)(strip[k] - minIndex));
+					}
+				}
+				else
+				{
+					chunk.stripFirstIndex = stripIndicesWide.size();
+					stripIndicesWide.insert(stripIndicesWide.end(), strip.begin(), strip.end());
+				}
+			}
+
+			//the triangle lists are neither kept nor uploaded
+			const size_t listBytes = indicesEBO.size() * sizeof(unsigned int);
+			std::vector<unsigned int>().swap(indicesEBO);
+			for(unsigned int c=0; c<chunks.size(); c++)
+			{
+				chunks[c].firstIndex = 0;
+				chunks[c].indexCount = 0;
+			}
+			std::cout << "Triangle strips: " << stripIndicesShort.size() * sizeof(unsigned short) + stripIndicesWide.size() * sizeof(unsigned int)
+				<< " bytes of indices instead of " << listBytes << std::endl;
+		}
+
+		void optimizeVertexCache()
+		{
+			const unsigned int numberOfVertices = vertices.size() / numberOfAttributes;
+			VertexCacheOptimizer optimizer;
+			VertexCacheStats before = optimizer.analyze(indicesEBO, 0, indicesEBO.size(), numberOfVertices);
+
+			for(unsigned int c=0; c<chunks.size(); c++)
+			{
+				optimizer.optimize(indicesEBO, chunks[c].firstIndex, chunks[c].indexCount);
+			}
+
+			//lay out the vertices in the order the triangles use them
+			std::vector<unsigned int> remap = VertexCacheOptimizer::fetchRemap(indicesEBO, numberOfVertices);
+			std::vector<glm::vec3> remappedVertices(vertices.size());
+			for(unsigned int v=0; v<numberOfVertices; v++)
+			{
+				for(unsigned int a=0; a<numberOfAttributes; a++)
+				{
+					remappedVertices[remap[v] * numberOfAttributes + a] = vertices[v * numberOfAttributes + a];
+				}
+			}
+			vertices.swap(remappedVertices);
+			for(unsigned int i=0; i<indicesEBO.size(); i++)
+			{
+				indicesEBO[i] = remap[indicesEBO[i]];
+			}
+			for(unsigned int c=0; c<cornerIndices.size(); c++)
+			{
+				if(cornerIndices[c] != -1)
+				{
+					cornerIndices[c] = remap[cornerIndices[c]];
+				}
+			}
+
+			VertexCacheStats after = optimizer.analyze(indicesEBO, 0, indicesEBO.size(), numberOfVertices);
+			std::cout << "Vertex cache: ACMR " << before.acmr << " -> " << after.acmr << ", ATVR " << before.atvr << " -> " << after.atvr << std::endl;
+		}
+
+		//Replaces the two triangles per cell with a right-triangulated irregular network within settings.maxError of the cells,
+		//triangulated chunk by chunk
+		void triangulateAdaptive(std::vector<std::vector<unsigned int> >& chunkIndices)
+		{
+			const int chunkColumns = (altitude.getColumns() + CHUNK_SIZE - 1) / CHUNK_SIZE;
+
+			for(unsigned int c=0; c<chunks.size(); c++)
+			{
+				std::vector<unsigned int>().swap(chunkIndices[c]);
+				chunks[c].minBound = glm::vec3(std::numeric_limits<float>::max());
+				chunks[c].maxBound = glm::vec3(-std::numeric_limits<float>::max());
+			}
+
+			triangulateTiles(CHUNK_SIZE, settings.maxError, [&](int tileRow, int tileColumn, Rtin& rtin, std::vector<int>& triangles)
+			{
+				const int firstRow = tileRow * CHUNK_SIZE;
+				const int firstColumn = tileColumn * CHUNK_SIZE;
+				const int chunk = tileRow * chunkColumns + tileColumn;
+				for(unsigned int t=0; t<triangles.size(); t+=6)
+				{
+					int minRow = firstRow + std::min(triangles[t], std::min(triangles[t + 2], triangles[t + 4]));
+					int minColumn = firstColumn + std::min(triangles[t + 1], std::min(triangles[t + 3], triangles[t + 5]));
+					int maxRow = firstRow + std::max(triangles[t], std::max(triangles[t + 2], triangles[t + 4]));
+					int maxColumn = firstColumn + std::max(triangles[t + 1], std::max(triangles[t + 3], triangles[t + 5]));
+
+					//single cell triangles may lie on holes, the bigger ones never do
+					if(maxRow - minRow == 1 && maxColumn - minColumn == 1 && altitude.isHoleCell(minRow, minColumn))
+					{
+						continue;
+					}
+
+					for(int k=0; k<6; k+=2)
+					{
+						int index = getCornerIndex(firstRow + triangles[t + k], firstColumn + triangles[t + k + 1]);
+						chunkIndices[chunk].push_back(index);
+						growBounds(chunks[chunk], vertices[index * numberOfAttributes]);
+					}
+				}
+			});
+		}
+
+		//Lays out the indices chunk after chunk, dropping the chunks made only of holes
+		void buildChunks(std::vector<std::vector<unsigned int> >& chunkIndices)
+		{
+			std::vector<SurfaceChunk> allChunks;
+			allChunks.swap(chunks);
+
+			for(unsigned int c=0; c<chunkIndices.size(); c++)
+			{
+				if(chunkIndices[c].empty())
+				{
+					continue;
+				}
+
+				SurfaceChunk chunk = allChunks[c];
+				chunk.firstIndex = indicesEBO.size();
+				chunk.indexCount = chunkIndices[c].size();
+				indicesEBO.insert(indicesEBO.end(), chunkIndices[c].begin(), chunkIndices[c].end());
+				std::vector<unsigned int>().swap(chunkIndices[c]);
+
+				chunks.push_back(chunk);
+				chunkBoxes.addBox(chunk.minBound, chunk.maxBound);
+			}
+		}
+
+		//Orders the visible chunks by the distance of their boxes from the viewer, the nearest first, so that the depth test
+		//rejects the hidden fragments of the farther ones before they are shaded
+		void sortVisibleChunks(const glm::vec3& viewPosition)
+		{
+			chunkDistances.resize(chunks.size());
+			for(unsigned int i=0; i<visibleChunks.size(); i++)
+			{
+				const SurfaceChunk& chunk = chunks[visibleChunks[i]];
+				chunkDistances[visibleChunks[i]] = boxDistanceSquared(viewPosition, chunk.minBound, chunk.maxBound);
+			}
+			std::sort(visibleChunks.begin(), visibleChunks.end(), [this](const unsigned int a, const unsigned int b)
+			{
+				return chunkDistances[a] < chunkDistances[b];
+			});
+		}
+
+		void cullOccludedChunks(HiZCuller* occlusion)
+		{
+			if(occlusion == NULL)
+			{
+				return;
+			}
+			visibleChunks.erase(std::remove_if(visibleChunks.begin(), visibleChunks.end(), [this, occlusion](const unsigned int c)
+			{
+				return occlusion->isOccluded(chunks[c].minBound, chunks[c].maxBound);
+			}), visibleChunks.end());
+		}
+
+		void clear()
+		{
+			residency = RESIDENCY_KEEP;
+			altitude.clear();
+			lava.clear();
+			temperature.clear();
+			vertices.clear();
+			indicesEBO.clear();
+			chunks.clear();
+			chunkBoxes.clear();
+			stripIndicesShort.clear();
+			stripIndicesWide.clear();
+			cornerIndices.clear();
+		}
+
+		void writeMatrix(MeshCacheWriter& writer, Matrix& matrix)
+		{
+			int rows = matrix.isLoaded() ? matrix.getRows() : 0;
+			writer.write(rows);
+			if(rows == 0)
+			{
+				return;
+			}
+			writer.write(matrix.getColumns());
+			writer.write(matrix.getCellSize());
+			writer.write(matrix.getNoDataValue());
+			for(int i=0; i<rows; i++)
+			{
+				writer.writeArray(matrix.getRow(i), matrix.getColumns());
+			}
+		}
+
+		bool readMatrix(MeshCacheReader& reader, Matrix& matrix)
+		{
+			int rows = 0;
+			int columns = 0;
+			float cellSize = 0.0f;
+			float noDataValue = 0.0f;
+			if(!reader.read(rows))
+			{
+				return false;
+			}
+			if(rows == 0)
+			{
+				return true;
+			}
+			if(!reader.read(columns) || !reader.read(cellSize) || !reader.read(noDataValue))
+			{
+				return false;
+			}
+			const float* values = reader.getArray<float>((unsigned long long)rows * columns);
+			if(values == NULL)
+			{
+				return false;
+			}
+			matrix.allocate(rows, columns, cellSize, noDataValue);
+			for(int i=0; i<rows; i++)
+			{
+				std::memcpy(matrix.getRow(i), values + i * columns, sizeof(float) * columns);
+			}
+			matrix.computeRange();
+			return true;
+		}
+
+		void setCornerIndex(const int row, const int column, const int index)
+		{
+			int& corner = cornerIndices[row * (altitude.getColumns() + 1) + column];
+			if(corner == -1)
+			{
+				corner = index;
+			}
+		}
+
+		void growBounds(SurfaceChunk& chunk, const glm::vec3& vertex)
+		{
+			chunk.minBound = glm::min(chunk.minBound, vertex);
+			chunk.maxBound = glm::max(chunk.maxBound, vertex);
 		}
 
 		void inizializeIndexRow()
 		{	
+			delete [] currentRowIndices;
+			delete [] lastRowIndices;
 			currentRowIndices = new int[altitude.getColumns() + 1];
 			lastRowIndices = new int[altitude.getColumns() + 1];
 			for (int i = 0; i < altitude.getColumns() + 1; i++)
@@ -302,17 +1342,6 @@ class Surface
 			return glm::vec3(x, y, 0.0f);
 		}
 
-		float computeRedValue(int i, int j)
-		{
-			float redValue = temperature.getValue(i, j);
-			if (redValue != 0)
-			{
-				redValue -= temperature.getMinValue();
-				redValue /= (temperature.getMaxValue() - temperature.getMinValue());
-			}
-			return redValue;
-		}
-
 		void printRowIndices()
 		{
 			std::cout<<"LAST ROW: \n";
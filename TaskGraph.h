@@ -0,0 +1,265 @@
+#ifndef TASKGRAPH_H
+#define TASKGRAPH_H
+
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <deque>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <algorithm>
+
+#include "Profiler.h"
+
+//Where a task runs: on the worker pool, or on the thread calling run, the only one with the GL context
+enum TaskThread
+{
+	TASK_WORKER,
+	TASK_MAIN
+};
+
+struct Task
+{
+	std::string name;
+	std::function<void()> work;
+	//for a main thread task, false while its work would only block, empty if it never would
+	std::function<bool()> canStart;
+	TaskThread thread;
+	std::vector<int> dependencies;
+	std::vector<int> dependents;
+	//dependencies not finished yet
+	int remaining;
+	//milliseconds since run started
+	double ready;
+	double start;
+	double end;
+};
+
+//Tasks run as soon as the tasks they depend on are finished, the worker ones concurrently on a pool and the main
+//thread ones in the order they become ready, skipping those whose canStart says their work would block. printReport
+//shows when every task ran and the chain of tasks that bounded the whole run
+class TaskGraph
+{
+	public:
+	TaskGraph(const unsigned int numberOfWorkers = std::max(2u, std::thread::hardware_concurrency())):numberOfWorkers(numberOfWorkers), finished(0), stopping(false), duration(0)
+	{}
+
+	//The dependencies must have been added before. canStart is polled for a main thread task once its dependencies are
+	//finished, until it returns true, while the other main thread tasks run
+	int addTask(const std::string& name, const std::function<void()>& work, const TaskThread thread = TASK_WORKER, const std::vector<int>& dependencies = std::vector<int>(),
+		const std::function<bool()>& canStart = std::function<bool()>())
+	{
+		Task task;
+		task.name = name;
+		task.work = work;
+		task.canStart = canStart;
+		task.thread = thread;
+		task.dependencies = dependencies;
+		task.remaining = dependencies.size();
+		task.ready = task.start = task.end = 0.0;
+		tasks.push_back(task);
+		for(unsigned int d=0; d<dependencies.size(); d++)
+		{
+			tasks[dependencies[d]].dependents.push_back(tasks.size() - 1);
+		}
+		return tasks.size() - 1;
+	}
+
+	//Runs every task and returns when all are finished
+	void run()
+	{
+		begin = std::chrono::steady_clock::now();
+		finished = 0;
+		stopping = false;
+		std::unique_lock<std::mutex> lock(mutex);
+		for(unsigned int t=0; t<tasks.size(); t++)
+		{
+			if(tasks[t].remaining == 0)
+			{
+				schedule(t);
+			}
+		}
+
+		std::vector<std::thread> workers;
+		for(unsigned int w=0; w<numberOfWorkers; w++)
+		{
+			workers.push_back(std::thread(&TaskGraph::workLoop, this));
+		}
+
+		while(finished < tasks.size())
+		{
+			int t = nextMainTask();
+			if(t == -1)
+			{
+				//tasks not able to start yet are polled again shortly
+				if(mainQueue.empty())
+				{
+					mainReady.wait(lock);
+				}
+				else
+				{
+					mainReady.wait_for(lock, std::chrono::milliseconds(1));
+				}
+				continue;
+			}
+			execute(t, lock);
+		}
+
+		stopping = true;
+		workerReady.notify_all();
+		lock.unlock();
+		for(unsigned int w=0; w<workers.size(); w++)
+		{
+			workers[w].join();
+		}
+		duration = elapsed();
+	}
+
+	//Timeline of the tasks, then the critical path: from the task that finished last, back through the dependency that
+	//finished last each time. Wait is the time a task spent ready but queued behind others
+	void printReport()
+	{
+		std::cout << std::fixed << std::setprecision(1);
+		std::cout << "Startup: " << tasks.size() << " tasks in " << duration << " ms on " << numberOfWorkers << " workers" << std::endl;
+		for(unsigned int t=0; t<tasks.size(); t++)
+		{
+			std::cout << "  " << std::setw(8) << tasks[t].start << " ms " << std::setw(8) << tasks[t].end - tasks[t].start << " ms  "
+				<< (tasks[t].thread == TASK_MAIN ? "main   " : "worker ") << tasks[t].name << std::endl;
+		}
+
+		std::vector<int> path;
+		int last = -1;
+		for(unsigned int t=0; t<tasks.size(); t++)
+		{
+			if(last == -1 || tasks[t].end > tasks[last].end)
+			{
+				last = t;
+			}
+		}
+		while(last != -1)
+		{
+			path.push_back(last);
+			int previous = -1;
+			for(unsigned int d=0; d<tasks[last].dependencies.size(); d++)
+			{
+				int dependency = tasks[last].dependencies[d];
+				if(previous == -1 || tasks[dependency].end > tasks[previous].end)
+				{
+					previous = dependency;
+				}
+			}
+			last = previous;
+		}
+
+		std::cout << "Critical path:" << std::endl;
+		double running = 0.0;
+		for(int p=path.size() - 1; p>=0; p--)
+		{
+			const Task& task = tasks[path[p]];
+			running += task.end - task.start;
+			std::cout << "  " << std::setw(8) << task.end - task.start << " ms  wait " << std::setw(6) << task.start - task.ready << " ms  " << task.name << std::endl;
+		}
+		std::cout << "  " << running << " of " << duration << " ms spent running the tasks on the path" << std::endl;
+		std::cout << std::defaultfloat << std::setprecision(6);
+	}
+
+	private:
+		std::vector<Task> tasks;
+		unsigned int numberOfWorkers;
+		unsigned int finished;
+		bool stopping;
+		double duration;
+		std::chrono::steady_clock::time_point begin;
+
+		std::mutex mutex;
+		std::condition_variable mainReady;
+		std::condition_variable workerReady;
+		std::deque<int> mainQueue;
+		std::deque<int> workerQueue;
+
+		double elapsed()
+		{
+			return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+		}
+
+		//Call it with the mutex locked
+		void schedule(const int t)
+		{
+			tasks[t].ready = elapsed();
+			if(tasks[t].thread == TASK_MAIN)
+			{
+				mainQueue.push_back(t);
+				mainReady.notify_one();
+			}
+			else
+			{
+				workerQueue.push_back(t);
+				workerReady.notify_one();
+			}
+		}
+
+		//Takes the first queued main thread task able to start, -1 if none. Call it with the mutex locked
+		int nextMainTask()
+		{
+			for(std::deque<int>::iterator it=mainQueue.begin(); it!=mainQueue.end(); ++it)
+			{
+				int t = *it;
+				if(!tasks[t].canStart || tasks[t].canStart())
+				{
+					mainQueue.erase(it);
+					return t;
+				}
+			}
+			return -1;
+		}
+
+		//Runs a task with the mutex unlocked, then schedules the tasks waiting only for it
+		void execute(const int t, std::unique_lock<std::mutex>& lock)
+		{
+			tasks[t].start = elapsed();
+			lock.unlock();
+			{
+				ProfileScope scope(tasks[t].name.c_str());
+				tasks[t].work();
+			}
+			lock.lock();
+			tasks[t].end = elapsed();
+
+			finished++;
+			for(unsigned int d=0; d<tasks[t].dependents.size(); d++)
+			{
+				int dependent = tasks[t].dependents[d];
+				if(--tasks[dependent].remaining == 0)
+				{
+					schedule(dependent);
+				}
+			}
+			if(finished == tasks.size())
+			{
+				mainReady.notify_one();
+			}
+		}
+
+		void workLoop()
+		{
+			Profiler::get().nameThread("task worker");
+			std::unique_lock<std::mutex> lock(mutex);
+			while(!stopping)
+			{
+				if(workerQueue.empty())
+				{
+					workerReady.wait(lock);
+					continue;
+				}
+				int t = workerQueue.front();
+				workerQueue.pop_front();
+				execute(t, lock);
+			}
+		}
+};
+
+#endif
@@ -0,0 +1,489 @@
+#ifndef TERRAINLOD_H
+#define TERRAINLOD_H
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+#include "Surface.h"
+#include "Frustum.h"
+#include "HiZ.h"
+#include "Rtin.h"
+#include "VertexCache.h"
+#include "Profiler.h"
+#include <vector>
+#include <map>
+#include <queue>
+#include <cmath>
+#include <limits>
+#include <algorithm>
+
+//Vertical error in metres allowed to the first coarse level over a surface meshed with every cell
+const float LOD_MIN_ERROR = 0.5f;
+//Factor between the errors of a level and of the level below it
+const float LOD_ERROR_GROWTH = 2.0f;
+//Skirts hang the cell size plus this many times the error of the parent level below the border
+const float LOD_SKIRT_ERROR_FACTOR = 2.0f;
+//Version of the way the levels and the skirts are triangulated, part of the cache key: bump it when that changes
+const unsigned int LOD_BUILD_VERSION = 1;
+
+//Node of the level of detail quadtree. A node of level k covers CHUNK_SIZE << k cells per side, triangulated within twice
+//the error of level k - 1, so every node costs at most the triangles of its children. Level 0 nodes are the chunks of the Surface
+struct LodNode
+{
+	int level;
+	int row;
+	int column;
+	int children[4];
+	float geometricError;
+	glm::vec3 minBound;
+	glm::vec3 maxBound;
+	unsigned int firstIndex;
+	unsigned int indexCount;
+	unsigned int skirtFirstIndex;
+	unsigned int skirtIndexCount;
+};
+
+//Quadtree of coarser meshes over a Surface, selected per frame by screen space error under a triangle budget. The coarse
+//levels are the adaptive triangulation of the surface with a doubled error bound per level, kept inside the nodes.
+//Cracks between nodes of different levels are hidden by skirts hanging below the edges of the node on its border
+class TerrainLod
+{
+	public:
+	TerrainLod():pixelError(2.0f), triangleBudget(1000000), surface(NULL), columns(0), rows(0)
+	{}
+
+	//Appends the coarse levels and the skirts to the vertices and indices of the surface: call it before uploading them
+	void build(Surface& source)
+	{
+		ProfileScope scope("lod build");
+		surface = &source;
+		rows = surface->getRows();
+		columns = surface->getColumns();
+		nodes.clear();
+		levelOffsets.clear();
+		levelRows.clear();
+		levelColumns.clear();
+
+		int nodeRows = (rows + CHUNK_SIZE - 1) / CHUNK_SIZE;
+		int nodeColumns = (columns + CHUNK_SIZE - 1) / CHUNK_SIZE;
+		chunkAt.assign(nodeRows * nodeColumns, -1);
+		for(unsigned int c=0; c<surface->chunks.size(); c++)
+		{
+			chunkAt[surface->chunks[c].row * nodeColumns + surface->chunks[c].column] = c;
+		}
+
+		float maxError = surface->getSettings().maxError;
+		for(int level=0; ; level++)
+		{
+			levelOffsets.push_back(nodes.size());
+			levelRows.push_back(nodeRows);
+			levelColumns.push_back(nodeColumns);
+
+			if(level == 0)
+			{
+				for(int r=0; r<nodeRows; r++)
+				{
+					for(int c=0; c<nodeColumns; c++)
+					{
+						buildChunkNode(r, c);
+					}
+				}
+			}
+			else
+			{
+				//a multiple of the error of the level below, LOD_MIN_ERROR over the full resolution
+				maxError = maxError > 0.0f ? maxError * LOD_ERROR_GROWTH : LOD_MIN_ERROR;
+				buildLevel(level, maxError);
+			}
+
+			if(nodeRows <= 1 && nodeColumns <= 1)
+			{
+				break;
+			}
+			nodeRows = (nodeRows + 1) / 2;
+			nodeColumns = (nodeColumns + 1) / 2;
+		}
+
+		//skirts need the error of the parent level, known only now
+		VertexCacheOptimizer optimizer;
+		for(unsigned int n=0; n<nodes.size(); n++)
+		{
+			if(nodes[n].level > 0)
+			{
+				optimizer.optimize(surface->indicesEBO, nodes[n].firstIndex, nodes[n].indexCount);
+			}
+			buildSkirt(n);
+		}
+
+		std::vector<int>().swap(chunkAt);
+	}
+
+	//Adds to key the constants that change the coarse levels and the skirts
+	static void addToCacheKey(MeshCacheKey& key)
+	{
+		key.add(LOD_MIN_ERROR);
+		key.add(LOD_ERROR_GROWTH);
+		key.add(LOD_SKIRT_ERROR_FACTOR);
+		key.add(LOD_BUILD_VERSION);
+	}
+
+	//Writes the quadtree: the coarse levels and skirts themselves are in the tables of the surface
+	void writeCache(MeshCacheWriter& writer)
+	{
+		writer.write(rows);
+		writer.write(columns);
+		writer.writeVector(nodes);
+		writer.writeVector(levelOffsets);
+		writer.writeVector(levelRows);
+		writer.writeVector(levelColumns);
+	}
+
+	//Replaces build for a surface read from the same cache entry
+	bool readCache(MeshCacheReader& reader, Surface& source)
+	{
+		surface = &source;
+		return reader.read(rows) && reader.read(columns) && reader.readVector(nodes) && reader.readVector(levelOffsets)
+			&& reader.readVector(levelRows) && reader.readVector(levelColumns);
+	}
+
+	//Fills counts and offsets with the nodes to draw from the camera, ready for glMultiDrawElements, leaving out those the
+	//occlusion culler, if any, finds hidden. Returns the number of triangles to draw
+	unsigned int select(const glm::vec3& cameraPosition, const float fieldOfView, const float viewportHeight, const Frustum& frustum, std::vector<GLsizei>& counts, std::vector<const void*>& offsets, HiZCuller* occlusion = NULL)
+	{
+		counts.clear();
+		offsets.clear();
+		selected.clear();
+		if(nodes.empty())
+		{
+			return 0;
+		}
+
+		const float pixelsPerRadian = viewportHeight / (2.0f * std::tan(fieldOfView * 0.5f));
+		std::priority_queue<std::pair<float, unsigned int> > candidates;
+
+		unsigned int triangles = 0;
+		for(unsigned int n=levelOffsets.back(); n<nodes.size(); n++)
+		{
+			if(isNodeVisible(nodes[n], frustum))
+			{
+				selected.push_back(n);
+				triangles += nodeTriangles(nodes[n]);
+				candidates.push(std::make_pair(screenError(nodes[n], cameraPosition, pixelsPerRadian), selected.size() - 1));
+			}
+		}
+
+		//refine the worst looking node first, until it looks good enough or the budget is over
+		while(!candidates.empty())
+		{
+			float error = candidates.top().first;
+			unsigned int slot = candidates.top().second;
+			candidates.pop();
+			if(error <= pixelError)
+			{
+				break;
+			}
+
+			const LodNode& node = nodes[selected[slot]];
+			if(node.level == 0)
+			{
+				continue;
+			}
+
+			unsigned int childrenTriangles = 0;
+			for(int k=0; k<4; k++)
+			{
+				if(node.children[k] != -1 && isNodeVisible(nodes[node.children[k]], frustum))
+				{
+					childrenTriangles += nodeTriangles(nodes[node.children[k]]);
+				}
+			}
+			if(triangles - nodeTriangles(node) + childrenTriangles > triangleBudget)
+			{
+				continue;
+			}
+			triangles = triangles - nodeTriangles(node) + childrenTriangles;
+
+			int children[4] = {node.children[0], node.children[1], node.children[2], node.children[3]};
+			selected[slot] = REFINED;
+			for(int k=0; k<4; k++)
+			{
+				if(children[k] != -1 && isNodeVisible(nodes[children[k]], frustum))
+				{
+					selected.push_back(children[k]);
+					candidates.push(std::make_pair(screenError(nodes[children[k]], cameraPosition, pixelsPerRadian), selected.size() - 1));
+				}
+			}
+		}
+
+		//nearest nodes first, for the depth test to reject what they hide before it is shaded
+		selected.erase(std::remove_if(selected.begin(), selected.end(), [](const unsigned int n){ return n == REFINED; }), selected.end());
+		std::sort(selected.begin(), selected.end(), [this, &cameraPosition](const unsigned int a, const unsigned int b)
+		{
+			return boxDistanceSquared(cameraPosition, nodes[a].minBound, nodes[a].maxBound) < boxDistanceSquared(cameraPosition, nodes[b].minBound, nodes[b].maxBound);
+		});
+
+		for(unsigned int s=0; s<selected.size(); s++)
+		{
+			const LodNode& node = nodes[selected[s]];
+			if(occlusion != NULL && occlusion->isOccluded(node.minBound, node.maxBound))
+			{
+				triangles -= nodeTriangles(node);
+				continue;
+			}
+			if(node.indexCount > 0)
+			{
+				counts.push_back(node.indexCount);
+				offsets.push_back((const void*)(node.firstIndex * sizeof(unsigned int)));
+			}
+			if(node.skirtIndexCount > 0)
+			{
+				counts.push_back(node.skirtIndexCount);
+				offsets.push_back((const void*)(node.skirtFirstIndex * sizeof(unsigned int)));
+			}
+		}
+		return triangles;
+	}
+
+	unsigned int getNumberOfLevels()
+	{
+		return levelOffsets.size();
+	}
+
+	//Memory of the quadtree, whose indices are part of the surface
+	size_t getCpuBytes()
+	{
+		return nodes.capacity() * sizeof(LodNode) + levelOffsets.capacity() * sizeof(unsigned int) + levelRows.capacity() * sizeof(int)
+			+ levelColumns.capacity() * sizeof(int) + selected.capacity() * sizeof(unsigned int) + chunkAt.capacity() * sizeof(int);
+	}
+
+	//Maximum error in pixels tolerated on screen
+	float pixelError;
+	//Maximum number of triangles selected per frame
+	unsigned int triangleBudget;
+
+	private:
+		static const unsigned int REFINED = 0xFFFFFFFF;
+
+		Surface* surface;
+		int columns;
+		int rows;
+		std::vector<LodNode> nodes;
+		std::vector<unsigned int> levelOffsets;
+		std::vector<int> levelRows;
+		std::vector<int> levelColumns;
+		std::vector<unsigned int> selected;
+		std::vector<int> chunkAt;
+
+		LodNode emptyNode(const int level, const int row, const int column)
+		{
+			LodNode node;
+			node.level = level;
+			node.row = row;
+			node.column = column;
+			node.geometricError = 0.0f;
+			node.minBound = glm::vec3(std::numeric_limits<float>::max());
+			node.maxBound = glm::vec3(-std::numeric_limits<float>::max());
+			node.firstIndex = 0;
+			node.indexCount = 0;
+			node.skirtFirstIndex = 0;
+			node.skirtIndexCount = 0;
+			for(int k=0; k<4; k++)
+			{
+				node.children[k] = -1;
+			}
+			return node;
+		}
+
+		//Full resolution: reuses the indices of the chunk
+		void buildChunkNode(const int row, const int column)
+		{
+			LodNode node = emptyNode(0, row, column);
+			int c = chunkAt[row * levelColumns[0] + column];
+			if(c != -1)
+			{
+				const SurfaceChunk& chunk = surface->chunks[c];
+				node.firstIndex = chunk.firstIndex;
+				node.indexCount = chunk.indexCount;
+				node.minBound = chunk.minBound;
+				node.maxBound = chunk.maxBound;
+				node.geometricError = surface->getSettings().maxError;
+			}
+			nodes.push_back(node);
+		}
+
+		//Triangulates the grid within maxError node by node of the level, so that only the network of one node is held
+		void buildLevel(const int level, const float maxError)
+		{
+			const int size = CHUNK_SIZE << level;
+			const int nodeColumns = levelColumns[level];
+			std::vector<std::vector<unsigned int> > nodeIndices(levelRows[level] * nodeColumns);
+			std::vector<float> nodeErrors(nodeIndices.size(), 0.0f);
+			surface->triangulateTiles(size, maxError, [&](int nodeRow, int nodeColumn, Rtin& rtin, std::vector<int>& triangles)
+			{
+				const int firstRow = nodeRow * size;
+				const int firstColumn = nodeColumn * size;
+				const int n = nodeRow * nodeColumns + nodeColumn;
+				for(unsigned int t=0; t<triangles.size(); t+=6)
+				{
+					int minRow = firstRow + std::min(triangles[t], std::min(triangles[t + 2], triangles[t + 4]));
+					int minColumn = firstColumn + std::min(triangles[t + 1], std::min(triangles[t + 3], triangles[t + 5]));
+					int maxRow = firstRow + std::max(triangles[t], std::max(triangles[t + 2], triangles[t + 4]));
+					int maxColumn = firstColumn + std::max(triangles[t + 1], std::max(triangles[t + 3], triangles[t + 5]));
+
+					//single cell triangles may lie on holes, the bigger ones never do
+					if(maxRow - minRow == 1 && maxColumn - minColumn == 1 && surface->isHoleCell(minRow, minColumn))
+					{
+						continue;
+					}
+
+					for(int k=0; k<6; k+=2)
+					{
+						nodeIndices[n].push_back(surface->getCornerIndex(firstRow + triangles[t + k], firstColumn + triangles[t + k + 1]));
+					}
+					nodeErrors[n] = std::max(nodeErrors[n], rtin.getError(triangles[t], triangles[t + 1], triangles[t + 2], triangles[t + 3]));
+				}
+			});
+
+			for(unsigned int n=0; n<nodeIndices.size(); n++)
+			{
+				LodNode node = emptyNode(level, n / nodeColumns, n % nodeColumns);
+				for(int k=0; k<4; k++)
+				{
+					int childRow = node.row * 2 + k / 2;
+					int childColumn = node.column * 2 + k % 2;
+					if(childRow < levelRows[level - 1] && childColumn < levelColumns[level - 1])
+					{
+						int child = levelOffsets[level - 1] + childRow * levelColumns[level - 1] + childColumn;
+						if(nodes[child].indexCount == 0)
+						{
+							continue;
+						}
+						node.children[k] = child;
+						node.minBound = glm::min(node.minBound, nodes[child].minBound);
+						node.maxBound = glm::max(node.maxBound, nodes[child].maxBound);
+						node.geometricError = std::max(node.geometricError, nodes[child].geometricError);
+					}
+				}
+				node.geometricError = std::max(node.geometricError, nodeErrors[n]);
+
+				node.firstIndex = surface->indicesEBO.size();
+				node.indexCount = nodeIndices[n].size();
+				surface->indicesEBO.insert(surface->indicesEBO.end(), nodeIndices[n].begin(), nodeIndices[n].end());
+				nodes.push_back(node);
+			}
+		}
+
+		//Hangs a vertical strip below the edges of the node triangles lying on its border, deep enough to cover the gap
+		//towards a coarser neighbour
+		void buildSkirt(const unsigned int n)
+		{
+			LodNode& node = nodes[n];
+			if(node.indexCount == 0)
+			{
+				return;
+			}
+
+			float depth = surface->getCellSize();
+			if(node.level + 1 < (int)levelOffsets.size())
+			{
+				const LodNode& parent = nodes[levelOffsets[node.level + 1] + (node.row / 2) * levelColumns[node.level + 1] + node.column / 2];
+				depth += LOD_SKIRT_ERROR_FACTOR * parent.geometricError;
+			}
+
+			const int size = CHUNK_SIZE << node.level;
+			const int firstRow = node.row * size;
+			const int firstColumn = node.column * size;
+			const int lastRow = std::min(rows, firstRow + size);
+			const int lastColumn = std::min(columns, firstColumn + size);
+
+			//skirt vertex below every border vertex, shared by the two edges meeting there
+			std::map<unsigned int, unsigned int> skirtVertices;
+			node.skirtFirstIndex = surface->indicesEBO.size();
+			for(unsigned int i=node.firstIndex; i<node.firstIndex + node.indexCount; i+=3)
+			{
+				for(int e=0; e<3; e++)
+				{
+					unsigned int top = surface->indicesEBO[i + e];
+					unsigned int nextTop = surface->indicesEBO[i + (e + 1) % 3];
+					int row = vertexRow(top);
+					int column = vertexColumn(top);
+					int nextRow = vertexRow(nextTop);
+					int nextColumn = vertexColumn(nextTop);
+					bool border = (row == nextRow && (row == firstRow || row == lastRow))
+						|| (column == nextColumn && (column == firstColumn || column == lastColumn));
+					if(!border)
+					{
+						continue;
+					}
+
+					unsigned int bottom = skirtVertex(skirtVertices, top, depth);
+					unsigned int nextBottom = skirtVertex(skirtVertices, nextTop, depth);
+
+					surface->indicesEBO.push_back(top);
+					surface->indicesEBO.push_back(bottom);
+					surface->indicesEBO.push_back(nextTop);
+
+					surface->indicesEBO.push_back(bottom);
+					surface->indicesEBO.push_back(nextTop);
+					surface->indicesEBO.push_back(nextBottom);
+				}
+			}
+			node.skirtIndexCount = surface->indicesEBO.size() - node.skirtFirstIndex;
+			node.minBound.y -= depth;
+		}
+
+		unsigned int skirtVertex(std::map<unsigned int, unsigned int>& skirtVertices, const unsigned int index, const float depth)
+		{
+			std::map<unsigned int, unsigned int>::iterator found = skirtVertices.find(index);
+			if(found != skirtVertices.end())
+			{
+				return found->second;
+			}
+			unsigned int skirtIndex = addSkirtVertex(index, depth);
+			skirtVertices[index] = skirtIndex;
+			return skirtIndex;
+		}
+
+		//Corner of the grid a vertex stands on, from its position
+		int vertexRow(const unsigned int index)
+		{
+			return (int)std::floor(surface->vertices[index * surface->getNumberOfAttributes()].z / surface->getCellSize() + 0.5f);
+		}
+
+		int vertexColumn(const unsigned int index)
+		{
+			return (int)std::floor(surface->vertices[index * surface->getNumberOfAttributes()].x / surface->getCellSize() + 0.5f);
+		}
+
+		int addSkirtVertex(const int index, const float depth)
+		{
+			const unsigned int attributes = surface->getNumberOfAttributes();
+			int skirtIndex = surface->vertices.size() / attributes;
+			for(unsigned int a=0; a<attributes; a++)
+			{
+				surface->vertices.push_back(surface->vertices[index * attributes + a]);
+			}
+			surface->vertices[skirtIndex * attributes].y -= depth;
+			return skirtIndex;
+		}
+
+		unsigned int nodeTriangles(const LodNode& node)
+		{
+			return (node.indexCount + node.skirtIndexCount) / 3;
+		}
+
+		bool isNodeVisible(const LodNode& node, const Frustum& frustum)
+		{
+			return node.indexCount > 0 && frustum.isBoxVisible(node.minBound, node.maxBound);
+		}
+
+		float screenError(const LodNode& node, const glm::vec3& cameraPosition, const float pixelsPerRadian)
+		{
+			glm::vec3 closest = glm::min(glm::max(cameraPosition, node.minBound), node.maxBound);
+			float distance = std::max(glm::length(cameraPosition - closest), 1.0f);
+			return node.geometricError * pixelsPerRadian / distance;
+		}
+};
+
+#endif
@@ -0,0 +1,50 @@
+#ifndef UNIFORMBUFFER_H
+#define UNIFORMBUFFER_H
+
+#include <glad/glad.h>
+
+//Uniform buffer holding one Block, bound to a binding point that the programs map their block of the same layout to
+//with Shader::bindUniformBlock. Block must follow the std140 rules: vec3 padded to vec4, matrices as columns of vec4
+template <typename Block>
+class UniformBuffer
+{
+	public:
+	UniformBuffer():buffer(0), binding(0)
+	{}
+
+	void create(const unsigned int bindingPoint)
+	{
+		binding = bindingPoint;
+		glGenBuffers(1, &buffer);
+		glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+		glBufferData(GL_UNIFORM_BUFFER, sizeof(Block), NULL, GL_DYNAMIC_DRAW);
+		glBindBufferBase(GL_UNIFORM_BUFFER, binding, buffer);
+	}
+
+	//One upload for every program reading the block
+	void update(const Block& block)
+	{
+		glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+		glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(Block), &block);
+	}
+
+	void release()
+	{
+		if(buffer != 0)
+		{
+			glDeleteBuffers(1, &buffer);
+		}
+		buffer = 0;
+	}
+
+	unsigned int getBinding()
+	{
+		return binding;
+	}
+
+	private:
+		unsigned int buffer;
+		unsigned int binding;
+};
+
+#endif
@@ -0,0 +1,289 @@
+#ifndef VERTEXCACHE_H
+#define VERTEXCACHE_H
+
+#include <vector>
+#include <cmath>
+
+//Size of the post-transform cache simulated by the optimizer and by the statistics
+const int VERTEX_CACHE_SIZE = 32;
+
+//Statistics of a triangle list against a FIFO post-transform cache
+struct VertexCacheStats
+{
+	//average cache misses per triangle: 3 is the worst, 0.5 the best for a regular grid
+	float acmr;
+	//average cache misses per referenced vertex: 1 is the best
+	float atvr;
+};
+
+//Reorders triangle lists for the post-transform vertex cache with Tom Forsyth's linear-speed algorithm,
+//then lets the caller lay out the vertices in order of first use for the vertex fetch
+class VertexCacheOptimizer
+{
+	public:
+	VertexCacheOptimizer()
+	{
+		for(int i=0; i<VERTEX_CACHE_SIZE; i++)
+		{
+			if(i < 3)
+			{
+				//the last triangle was just drawn: do not favour using its vertices again right away
+				cachePositionScore[i] = 0.75f;
+			}
+			else
+			{
+				cachePositionScore[i] = std::pow(1.0f - float(i - 3) / float(VERTEX_CACHE_SIZE - 3), 1.5f);
+			}
+		}
+		for(int i=0; i<VALENCE_SCORES; i++)
+		{
+			valenceScore[i] = i == 0 ? 0.0f : 2.0f / std::sqrt(float(i));
+		}
+	}
+
+	VertexCacheStats analyze(const std::vector<unsigned int>& indices, const unsigned int first, const unsigned int count, const unsigned int numberOfVertices)
+	{
+		std::vector<int> fifo(VERTEX_CACHE_SIZE, -1);
+		std::vector<unsigned char> referenced(numberOfVertices, 0);
+		unsigned int head = 0;
+		unsigned int misses = 0;
+		unsigned int uniqueVertices = 0;
+
+		for(unsigned int i=first; i<first + count; i++)
+		{
+			int vertex = indices[i];
+			bool hit = false;
+			for(int k=0; k<VERTEX_CACHE_SIZE; k++)
+			{
+				if(fifo[k] == vertex)
+				{
+					hit = true;
+					break;
+				}
+			}
+			if(!hit)
+			{
+				fifo[head] = vertex;
+				head = (head + 1) % VERTEX_CACHE_SIZE;
+				misses++;
+			}
+			if(!referenced[vertex])
+			{
+				referenced[vertex] = 1;
+				uniqueVertices++;
+			}
+		}
+
+		VertexCacheStats stats;
+		stats.acmr = count > 0 ? float(misses) / float(count / 3) : 0.0f;
+		stats.atvr = uniqueVertices > 0 ? float(misses) / float(uniqueVertices) : 0.0f;
+		return stats;
+	}
+
+	//Reorders in place the triangles of indices[first, first + count)
+	void optimize(std::vector<unsigned int>& indices, const unsigned int first, const unsigned int count)
+	{
+		const int numberOfTriangles = count / 3;
+		if(numberOfTriangles < 2)
+		{
+			return;
+		}
+
+		//local numbering of the vertices of the range
+		std::vector<unsigned int> localToGlobal;
+		std::vector<int> localIndices(count);
+		for(unsigned int i=0; i<count; i++)
+		{
+			unsigned int vertex = indices[first + i];
+			if(vertex >= globalToLocal.size())
+			{
+				globalToLocal.resize(vertex + 1, -1);
+			}
+			if(globalToLocal[vertex] == -1)
+			{
+				globalToLocal[vertex] = localToGlobal.size();
+				localToGlobal.push_back(vertex);
+			}
+			localIndices[i] = globalToLocal[vertex];
+		}
+		const int numberOfVertices = localToGlobal.size();
+
+		//triangles adjacent to every vertex
+		std::vector<int> remaining(numberOfVertices, 0);
+		for(unsigned int i=0; i<count; i++)
+		{
+			remaining[localIndices[i]]++;
+		}
+		std::vector<int> adjacencyOffset(numberOfVertices + 1, 0);
+		for(int v=0; v<numberOfVertices; v++)
+		{
+			adjacencyOffset[v + 1] = adjacencyOffset[v] + remaining[v];
+		}
+		std::vector<int> adjacency(count);
+		std::vector<int> filled(adjacencyOffset.begin(), adjacencyOffset.end() - 1);
+		for(int t=0; t<numberOfTriangles; t++)
+		{
+			for(int k=0; k<3; k++)
+			{
+				int vertex = localIndices[t * 3 + k];
+				adjacency[filled[vertex]++] = t;
+			}
+		}
+
+		std::vector<int> cachePosition(numberOfVertices, -1);
+		std::vector<float> vertexScore(numberOfVertices);
+		for(int v=0; v<numberOfVertices; v++)
+		{
+			vertexScore[v] = score(-1, remaining[v]);
+		}
+		std::vector<float> triangleScore(numberOfTriangles);
+		std::vector<unsigned char> emitted(numberOfTriangles, 0);
+		for(int t=0; t<numberOfTriangles; t++)
+		{
+			triangleScore[t] = vertexScore[localIndices[t * 3]] + vertexScore[localIndices[t * 3 + 1]] + vertexScore[localIndices[t * 3 + 2]];
+		}
+
+		std::vector<int> cache;
+		std::vector<int> newCache;
+		cache.reserve(VERTEX_CACHE_SIZE + 3);
+		newCache.reserve(VERTEX_CACHE_SIZE + 3);
+		int nextUnemitted = 0;
+		int bestTriangle = -1;
+
+		for(int output=0; output<numberOfTriangles; output++)
+		{
+			if(bestTriangle == -1)
+			{
+				//nothing useful in the cache: restart from the first triangle not emitted yet
+				while(emitted[nextUnemitted])
+				{
+					nextUnemitted++;
+				}
+				bestTriangle = nextUnemitted;
+			}
+
+			emitted[bestTriangle] = 1;
+			for(int k=0; k<3; k++)
+			{
+				int vertex = localIndices[bestTriangle * 3 + k];
+				indices[first + output * 3 + k] = localToGlobal[vertex];
+
+				//remove the triangle from the adjacency of the vertex
+				remaining[vertex]--;
+				int* begin = &adjacency[adjacencyOffset[vertex]];
+				int* end = begin + remaining[vertex];
+				for(int* a=begin; a<=end; a++)
+				{
+					if(*a == bestTriangle)
+					{
+						*a = *end;
+						break;
+					}
+				}
+			}
+
+			//move the vertices of the triangle to the front of the cache
+			newCache.clear();
+			for(int k=0; k<3; k++)
+			{
+				newCache.push_back(localIndices[bestTriangle * 3 + k]);
+			}
+			for(unsigned int c=0; c<cache.size(); c++)
+			{
+				int vertex = cache[c];
+				if(vertex != newCache[0] && vertex != newCache[1] && vertex != newCache[2])
+				{
+					newCache.push_back(vertex);
+				}
+			}
+			cache.swap(newCache);
+
+			//rescore the vertices in the cache and the ones just pushed out, then their triangles
+			for(unsigned int c=0; c<cache.size(); c++)
+			{
+				int vertex = cache[c];
+				int position = c < (unsigned int)VERTEX_CACHE_SIZE ? (int)c : -1;
+				cachePosition[vertex] = position;
+				vertexScore[vertex] = score(position, remaining[vertex]);
+			}
+
+			bestTriangle = -1;
+			float bestScore = -1.0f;
+			for(unsigned int c=0; c<cache.size(); c++)
+			{
+				int vertex = cache[c];
+				for(int a=adjacencyOffset[vertex]; a<adjacencyOffset[vertex] + remaining[vertex]; a++)
+				{
+					int t = adjacency[a];
+					triangleScore[t] = vertexScore[localIndices[t * 3]] + vertexScore[localIndices[t * 3 + 1]] + vertexScore[localIndices[t * 3 + 2]];
+					if(triangleScore[t] > bestScore)
+					{
+						bestScore = triangleScore[t];
+						bestTriangle = t;
+					}
+				}
+			}
+
+			if(cache.size() > (unsigned int)VERTEX_CACHE_SIZE)
+			{
+				cache.resize(VERTEX_CACHE_SIZE);
+			}
+		}
+
+		for(int v=0; v<numberOfVertices; v++)
+		{
+			globalToLocal[localToGlobal[v]] = -1;
+		}
+	}
+
+	//Builds the new position of every vertex, in order of first use by indices. Unused vertices follow, in their old order
+	static std::vector<unsigned int> fetchRemap(const std::vector<unsigned int>& indices, const unsigned int numberOfVertices)
+	{
+		const unsigned int unused = 0xFFFFFFFF;
+		std::vector<unsigned int> remap(numberOfVertices, unused);
+		unsigned int next = 0;
+		for(unsigned int i=0; i<indices.size(); i++)
+		{
+			if(remap[indices[i]] == unused)
+			{
+				remap[indices[i]] = next++;
+			}
+		}
+		for(unsigned int v=0; v<numberOfVertices; v++)
+		{
+			if(remap[v] == unused)
+			{
+				remap[v] = next++;
+			}
+		}
+		return remap;
+	}
+
+	private:
+		static const int VALENCE_SCORES = 32;
+
+		float cachePositionScore[VERTEX_CACHE_SIZE];
+		float valenceScore[VALENCE_SCORES];
+		std::vector<int> globalToLocal;
+
+		float score(const int position, const int remainingTriangles)
+		{
+			if(remainingTriangles == 0)
+			{
+				return -1.0f;
+			}
+
+			float result = position >= 0 ? cachePositionScore[position] : 0.0f;
+			if(remainingTriangles < VALENCE_SCORES)
+			{
+				result += valenceScore[remainingTriangles];
+			}
+			else
+			{
+				result += 2.0f / std::sqrt(float(remainingTriangles));
+			}
+			return result;
+		}
+};
+
+#endif
@@ -120,6 +120,14 @@ public:
         MovementSpeed=speed;
     }
 
+    // Points the camera by its Eular angles, in degrees
+    void setOrientation(const float yaw, const float pitch)
+    {
+        Yaw = yaw;
+        Pitch = pitch;
+        updateCameraVectors();
+    }
+
 private:
     // Calculates the front vector from the Camera's (updated) Eular Angles
     void updateCameraVectors()
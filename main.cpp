@@ -5,6 +5,21 @@
 #include "shader.h"
 #include "camera.h"
 #include "Surface.h"
+#include "TerrainLod.h"
+#include "LavaPlayback.h"
+#include "LavaOverlay.h"
+#include "SceneManager.h"
+#include "TaskGraph.h"
+#include "Headless.h"
+#include "Benchmark.h"
+#include "CameraPath.h"
+#include "Profiler.h"
+#include "UniformBuffer.h"
+#include "ProgramCache.h"
+#include "DynamicResolution.h"
+#include "Overdraw.h"
+#include "HiZ.h"
+#include "FrameCapture.h"
 #include "Model.h"
 
 #include <glm/glm.hpp>
@@ -13,22 +28,62 @@
 
 #include "stb_image.h"
 #include <iostream>
+#include <string>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <climits>
+#include <thread>
 
 void framebuffer_size_callback(GLFWwindow* window, int width, int height);
 void mouse_callback(GLFWwindow* window, double xpos, double ypos);
 void scroll_callback(GLFWwindow* window, double xoffset, double yoffset);
+void refresh_callback(GLFWwindow* window);
 void processInput(GLFWwindow *window);
 unsigned int loadTexture(char const * path);
 unsigned int loadVAO(unsigned int sizeVertices, glm::vec3* firstVertex, unsigned int sizeEBO, unsigned int* firstEBO);
+unsigned int loadStripVAO(unsigned int VAO, unsigned int sizeWide, unsigned int sizeShort);
+void setVertexAttributes();
+void uploadSurface(Surface& surface);
+void drawScene(Shader& surfaceShader, Shader& depthShader, Shader& hizShader, Shader& lavaShader, LavaOverlay* lavaOverlay, bool playbackActive);
+bool movementKeysHeld(GLFWwindow* window);
+void waitForNextFrame(bool animating, double frameStart);
+bool convertLavaFrames(const char* framePattern, const char* seriesPath, const unsigned int keyframeInterval);
 
 // settings
 const unsigned int SCR_WIDTH = 1280;
 const unsigned int SCR_HEIGHT = 1024;
+const float MAX_VERTICAL_ERROR = 1.0f; // metres allowed between the adaptive mesh and the DEM, 0 meshes every cell
 bool wireframeMode = false;
-bool colataMode = true;
-bool curtiMode = false;
-bool albanoMode = false;
+bool frustumCullingMode = true;
+bool frustumCullingKeyDown = false;
+bool lodMode = true;
+bool lodKeyDown = false;
 Surface* surface;
+TerrainLod* lod;
+
+// lava playback over the colata, enabled when the first frame of the sequence exists. The series are read instead of
+// the frames if present
+const char* LAVA_FRAMES = "./data/frames/lava_%04d.dat";
+const char* TEMPERATURE_FRAMES = "./data/frames/temperature_%04d.dat";
+const char* LAVA_SERIES = "./data/frames/lava.lvs";
+const char* TEMPERATURE_SERIES = "./data/frames/temperature.lvs";
+bool lavaOverlayMode = false; // --lava-overlay on draws the playback keyframes as the overlay mesh, the terrain left static
+int convertKeyframeInterval = 0; // --convert-frames N writes the series from the frames with a keyframe every N steps and exits
+LavaPlayback playback;
+bool lavaPlaybackMode = false;
+bool playKeyDown = false;
+bool stepForwardKeyDown = false;
+bool stepBackKeyDown = false;
+
+// meshes are saved here by the content of their grids and the settings, and read back by the next launches
+const char* MESH_CACHE_DIRECTORY = "./cache";
+
+// scenes are loaded when first selected, and the least recently used are dropped over the budget
+const size_t SCENE_MEMORY_BUDGET = 256 * 1024 * 1024;
+// bytes of a loading scene sent to the GPU per frame
+const size_t SCENE_UPLOAD_BYTES_PER_FRAME = 4 * 1024 * 1024;
+int selectedScene = 0;
 
 // camera
 Camera camera(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f), 45.0f);
@@ -37,121 +92,635 @@ float lastY = SCR_HEIGHT / 2.0f;
 bool firstMouse = true;
 float factorTimeSpeedCamera = 2.0f;
 
+// camera path: R starts recording the camera and saves it when pressed again, --camera-path replays one at a fixed step
+const char* CAMERA_PATH_FILE = "./camera_path.txt";
+const float REPLAY_TIME_STEP = 1.0f / 60.0f;
+CameraPath cameraPath;
+bool recordingMode = false;
+bool recordKeyDown = false;
+float recordingStart = 0.0f;
+bool replayMode = false;
+int replayFrame = 0;
+
+// camera and light, uploaded once per frame to a uniform buffer read by every program through its Frame block
+struct FrameUniforms
+{
+    glm::mat4 projection;
+    glm::mat4 view;
+    glm::vec4 viewPosition; // vec3 padded to 16 bytes as std140 does
+    glm::vec4 lightPosition;
+};
+const unsigned int FRAME_UNIFORMS_BINDING = 0;
+UniformBuffer<FrameUniforms> frameUniforms;
+
+// culling
+Frustum frustum;
+std::vector<GLsizei> drawCounts;
+std::vector<const void*> drawOffsets;
+DrawList shortStripDraws;
+DrawList wideStripDraws;
+
 // timing
 float deltaTime = 0.0f; // time between current frame and last frame
 float lastFrame = 0.0f;
 
-int main()
+// render on demand: a frame is drawn only when what it shows changes, the loop sleeping on the window events in between.
+// While something moves (held keys, lava playing, a scene loading, a camera path) frames follow each other, at most
+// maxFps of them per second if set. O switches to drawing every frame, as --frame-loop continuous starts
+bool onDemandMode = true;
+bool onDemandKeyDown = false;
+float maxFps = 0.0f; // 0 for no cap
+const double ON_DEMAND_IDLE_TIMEOUT = 0.5; // seconds waited for events before looking at the loaders again
+bool redrawRequested = true; // the window lost its content or changed size
+
+// what a frame shows, a frame equal to the last drawn one is not drawn again on demand
+struct ViewState
+{
+    glm::vec3 position;
+    float yaw;
+    float pitch;
+    float zoom;
+    int scene;
+    bool wireframe;
+    bool frustumCulling;
+    bool lod;
+    int lavaFrame;
+    float lavaBlend;
+
+    bool operator!=(const ViewState& other) const
+    {
+        return position != other.position || yaw != other.yaw || pitch != other.pitch || zoom != other.zoom || scene != other.scene
+            || wireframe != other.wireframe || frustumCulling != other.frustumCulling || lod != other.lod
+            || lavaFrame != other.lavaFrame || lavaBlend != other.lavaBlend;
+    }
+};
+ViewState getViewState(int scene);
+
+// dynamic resolution: --frame-time-target <ms> draws the moving frames at the fraction of the window size whose GPU time
+// meets the target, scaled up to the window. A still view is drawn again at the window size
+float frameTimeTarget = 0.0f; // 0 draws straight into the window
+DynamicResolution resolution;
+unsigned int renderWidth = SCR_WIDTH; // pixels of the frame being drawn
+unsigned int renderHeight = SCR_HEIGHT;
+
+// depth pre-pass: Z draws the depth of the terrain first with a program reading only the positions, then shades it with
+// the depth test on equal, so that every covered pixel is shaded once. The chunks are drawn front to back either way.
+// The shaded fragments per pixel are printed at every switch and at exit
+bool depthPrepassMode = false;
+bool depthPrepassKeyDown = false;
+OverdrawCounter overdraw;
+
+// the draw lists of the terrain, built once per frame and submitted by both passes
+enum TerrainDraw
+{
+    DRAW_LOD,
+    DRAW_STRIPS,
+    DRAW_CULLED,
+    DRAW_ALL
+};
+TerrainDraw buildTerrainDraws(const glm::mat4& viewProjectionModel, bool lavaPlayback);
+void submitTerrain(TerrainDraw draw, unsigned int maxDraws = UINT_MAX);
+void printOverdraw();
+
+// occlusion culling: H leaves out the chunks hidden behind the nearest ones, tested against a depth pyramid of the
+// frames before. Without camera motion the frames are drawn whole, a chunk uncovered shows up a few frames late.
+// The chunks culled per frame are printed at every switch and at exit
+bool occlusionCullingMode = false;
+bool occlusionCullingKeyDown = false;
+bool occlusionAllowed = true; // false for the frames of a still view in on-demand mode
+bool occlusionCulledFrame = false; // whether the last frame was culled, to be drawn again whole once the view is still
+HiZCuller hiz;
+void printOcclusion();
+
+// frame capture: F12 saves a screenshot, V starts and stops capturing every frame drawn, the frames read back and written
+// by worker threads without stalling the drawing. Sequences are PNG or PPM files or a Y4M video, and frames are drawn
+// continuously while capturing. --record on captures from the start, and stops at the end of a replayed camera path
+std::string captureDirectory = "./capture";
+CaptureFormat captureFormat = CAPTURE_Y4M;
+bool captureOnStart = false;
+bool screenshotKeyDown = false;
+bool captureKeyDown = false;
+FrameCapture capture;
+
+// headless benchmark: renders a scene along a camera path into a framebuffer object and writes the frame times.
+// The path is the replayed one if given, else a turn around the scene
+std::string benchmarkScene;
+int benchmarkFrames = 0; // 0 for the whole replayed path, or 300 frames of the turn
+std::string cameraPathFile;
+std::string benchmarkJson = "benchmark.json";
+std::string benchmarkPngDirectory;
+int benchmarkPngEvery = 1;
+const int BENCHMARK_WARMUP_FRAMES = 10; // rendered before measuring, at the first position of the path
+unsigned int shadedTrianglesQuery = 0; // when not 0, counts the triangles of the terrain shading pass alone
+
+// profiling: --profile <trace.json> times the loading and the phases of every frame on the CPU and the GPU, prints their
+// histograms at exit and writes the whole timeline as a Chrome trace
+std::string profilePath;
+GpuTimer gpuTimer;
+
+int main(int argc, char** argv)
 {
-    glfwInit();
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
-    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    //[--frame-loop on-demand|continuous] [--max-fps N] [--frame-time-target ms] [--depth-prepass on|off] [--occlusion-culling on|off] [--capture-format png|ppm|y4m] [--capture-directory dir] [--record on|off] [--lava-overlay on|off] [--convert-frames keyframeInterval] [--profile trace.json] [--camera-path file] [--benchmark <scene> [--frames N] [--json path] [--png directory] [--png-every N]]
+    for(int i=1; i<argc; i+=2)
+    {
+        std::string option = argv[i];
+        if(i+1 == argc)
+        {
+            std::cout << "Option " << option << " needs a value" << std::endl;
+            return -1;
+        }
+        if(option == "--benchmark")
+            benchmarkScene = argv[i+1];
+        else if(option == "--frames")
+            benchmarkFrames = std::max(1, std::atoi(argv[i+1]));
+        else if(option == "--json")
+            benchmarkJson = argv[i+1];
+        else if(option == "--png")
+            benchmarkPngDirectory = argv[i+1];
+        else if(option == "--png-every")
+            benchmarkPngEvery = std::max(1, std::atoi(argv[i+1]));
+        else if(option == "--camera-path")
+            cameraPathFile = argv[i+1];
+        else if(option == "--profile")
+            profilePath = argv[i+1];
+        else if(option == "--frame-loop")
+            onDemandMode = std::string(argv[i+1]) != "continuous";
+        else if(option == "--max-fps")
+            maxFps = std::max(0.0f, (float)std::atof(argv[i+1]));
+        else if(option == "--frame-time-target")
+            frameTimeTarget = std::max(0.0f, (float)std::atof(argv[i+1]));
+        else if(option == "--depth-prepass")
+            depthPrepassMode = std::string(argv[i+1]) == "on";
+        else if(option == "--occlusion-culling")
+            occlusionCullingMode = std::string(argv[i+1]) == "on";
+        else if(option == "--capture-format")
+            captureFormat = std::string(argv[i+1]) == "png" ? CAPTURE_PNG : (std::string(argv[i+1]) == "ppm" ? CAPTURE_PPM : CAPTURE_Y4M);
+        else if(option == "--capture-directory")
+            captureDirectory = argv[i+1];
+        else if(option == "--record")
+            captureOnStart = std::string(argv[i+1]) == "on";
+        else if(option == "--lava-overlay")
+            lavaOverlayMode = std::string(argv[i+1]) == "on";
+        else if(option == "--convert-frames")
+            convertKeyframeInterval = std::max(1, std::atoi(argv[i+1]));
+        else
+            std::cout << "Unknown option: " << option << std::endl;
+    }
+    if(convertKeyframeInterval > 0)
+    {
+        const bool converted = convertLavaFrames(LAVA_FRAMES, LAVA_SERIES, convertKeyframeInterval)
+            && convertLavaFrames(TEMPERATURE_FRAMES, TEMPERATURE_SERIES, convertKeyframeInterval);
+        return converted ? 0 : -1;
+    }
+    const bool headlessMode = !benchmarkScene.empty();
+    if(!profilePath.empty())
+    {
+        Profiler::get().enable();
+    }
+    if(!cameraPathFile.empty())
+    {
+        if(!cameraPath.load(cameraPathFile))
+        {
+            return -1;
+        }
+        replayMode = true;
+    }
 
-    GLFWwindow* window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "LearnOpenGL", NULL, NULL);
-    if (window == NULL)
+    GLFWwindow* window = NULL;
+    HeadlessContext headless;
+    if(headlessMode)
     {
-        std::cout << "Failed to create GLFW window" << std::endl;
-        glfwTerminate();
-        return -1;
+        if(!headless.create(3, 3))
+        {
+            return -1;
+        }
+        if (!gladLoadGLLoader((GLADloadproc)HeadlessContext::getProcAddress))
+        {
+            std::cout << "Failed to initialize GLAD" << std::endl;
+            return -1;
+        }
     }
-    glfwMakeContextCurrent(window);
+    else
+    {
+        glfwInit();
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+        glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+
+        window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "LearnOpenGL", NULL, NULL);
+        if (window == NULL)
+        {
+            std::cout << "Failed to create GLFW window" << std::endl;
+            glfwTerminate();
+            return -1;
+        }
+        glfwMakeContextCurrent(window);
+
+        glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
+        glfwSetCursorPosCallback(window, mouse_callback);
+        glfwSetScrollCallback(window, scroll_callback);
+        glfwSetWindowRefreshCallback(window, refresh_callback);
 
-    glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
-    glfwSetCursorPosCallback(window, mouse_callback);
-    glfwSetScrollCallback(window, scroll_callback);
+        glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
 
-    glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+        if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
+        {
+            std::cout << "Failed to initialize GLAD" << std::endl;
+            return -1;
+        }
+    }
+
+    SurfaceSettings surfaceSettings;
+    surfaceSettings.maxError = MAX_VERTICAL_ERROR;
+    surfaceSettings.preserveLava = true;
+    surfaceSettings.triangleStrips = (MAX_VERTICAL_ERROR == 0.0f);
+    //the lava of the colata is sampled at the vertices, a coarser mesh would lose the narrow flows. Its regular grid is
+    //drawn as triangle strips
+    SurfaceSettings colataSettings = surfaceSettings;
+    colataSettings.maxError = 0.0f;
+    colataSettings.triangleStrips = true;
+
+    SceneManager scenes(MESH_CACHE_DIRECTORY, SCENE_MEMORY_BUDGET, SCENE_UPLOAD_BYTES_PER_FRAME, uploadSurface);
+    //the colata keeps its vertices for the lava overlay, the others only what drawing needs
+    const int colata = scenes.addScene("colata", "./data/altitudes.dat", "", "", "./textures/surface.png", colataSettings, RESIDENCY_KEEP);
+    scenes.addScene("curti", "./data/DEM_Curti.asc", "", "", "./textures/white.png", surfaceSettings);
+    scenes.addScene("albano", "./data/DEM_Albano.asc", "", "", "./textures/white.png", surfaceSettings);
+
+    //the colata, or the scene benchmarked
+    int firstScene = colata;
+    if(headlessMode)
+    {
+        firstScene = -1;
+        for(int s=0; s<scenes.getNumberOfScenes(); s++)
+        {
+            if(scenes.getName(s) == benchmarkScene)
+                firstScene = s;
+        }
+        if(firstScene == -1)
+        {
+            std::cout << "Unknown scene: " << benchmarkScene << std::endl;
+            return -1;
+        }
+    }
+    selectedScene = firstScene;
 
-    if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
+    //the terrain is built without lava: with playback the shader applies it, otherwise it is drawn as an overlay. The
+    //frames are looked for only when the colata is shown first
+    if(firstScene == colata)
     {
-        std::cout << "Failed to initialize GLAD" << std::endl;
-        return -1;
+        const bool useLavaSeries = std::ifstream(LAVA_SERIES).good() && std::ifstream(TEMPERATURE_SERIES).good();
+        playback.open(useLavaSeries ? LAVA_SERIES : LAVA_FRAMES, useLavaSeries ? TEMPERATURE_SERIES : TEMPERATURE_FRAMES);
     }
+    lavaPlaybackMode = playback.getNumberOfFrames() > 0;
+    //a replay waits for the lava keyframes instead of drawing what the decoder has ready
+    playback.deterministic = replayMode;
 
-    Surface colata("./data/altitudes.dat","./data/lava.dat", "./data/temperature.dat");
-    colata.loadTexture("./textures/surface.png");
-    colata.VAO = loadVAO(colata.vertices.size(), &colata.vertices[0], colata.indicesEBO.size(), &colata.indicesEBO[0]);
+    frameUniforms.create(FRAME_UNIFORMS_BINDING);
 
-    Surface albano("./data/DEM_Albano.asc");
-    albano.loadTexture("./textures/white.png");
-    albano.VAO = loadVAO(albano.vertices.size(), &albano.vertices[0], albano.indicesEBO.size(), &albano.indicesEBO[0]);
+    //startup runs as a task graph: files are read and parsed on a worker pool, while the main thread, the only one with
+    //the GL context, compiles and uploads as soon as their inputs are ready
+    TaskGraph startup;
+    const int firstUpload = scenes.preload(firstScene, startup);
 
-    Surface curti("./data/DEM_Curti.asc");
-    curti.loadTexture("./textures/white.png");
-    curti.VAO = loadVAO(curti.vertices.size(), &curti.vertices[0], curti.indicesEBO.size(), &curti.indicesEBO[0]);    
-    
-    Shader surfaceShader("./shader/surface.vs", "./shader/surface.fs");
+    std::string surfaceVertexCode, surfaceFragmentCode, depthFragmentCode, hizVertexCode, hizFragmentCode, lavaVertexCode, lavaFragmentCode;
+    const int surfaceSources = startup.addTask("surface shader sources", [&]()
+    {
+        surfaceVertexCode = Shader::readFile("./shader/surface.vs");
+        surfaceFragmentCode = Shader::readFile("./shader/surface.fs");
+        depthFragmentCode = Shader::readFile("./shader/depth.fs");
+        hizVertexCode = Shader::readFile("./shader/hiz.vs");
+        hizFragmentCode = Shader::readFile("./shader/hiz.fs");
+    });
+    const int lavaSources = startup.addTask("lava shader sources", [&]()
+    {
+        lavaVertexCode = Shader::readFile("./shader/lava.vs");
+        lavaFragmentCode = Shader::readFile("./shader/lava.fs");
+    });
 
-    surfaceShader.use();
-    surfaceShader.setVec3("light.ambient", 0.3f, 0.3f, 0.3f);
-    surfaceShader.setVec3("light.diffuse", 0.8f, 0.8f, 0.8f);
-    surfaceShader.setVec3("light.specular", 1.0f, 1.0f, 1.0f);
-    surfaceShader.setFloat("light.constant", 1.0f);
-    surfaceShader.setFloat("light.linear", 0.00007);
-    surfaceShader.setFloat("light.quadratic", 0.00000035);
+    //the programs start before any is waited for, compiling side by side where the driver can, or come from the
+    //binaries of a previous launch. Each is linked once the driver has it ready, the other main tasks running meanwhile
+    ProgramCache programs(MESH_CACHE_DIRECTORY, headlessMode ? (GLADloadproc)HeadlessContext::getProcAddress : (GLADloadproc)glfwGetProcAddress);
+    Shader surfaceShader;
+    Shader depthShader;
+    Shader hizShader;
+    Shader lavaShader;
+    const int shaderStart = startup.addTask("shader compile start", [&]()
+    {
+        programs.start(surfaceShader, "surface", surfaceVertexCode, surfaceFragmentCode);
+        //the vertices of the terrain placed as surface.vs does, for the depth pre-pass
+        programs.start(depthShader, "depth", surfaceVertexCode, depthFragmentCode);
+        programs.start(hizShader, "hiz", hizVertexCode, hizFragmentCode);
+        programs.start(lavaShader, "lava", lavaVertexCode, lavaFragmentCode);
+    }, TASK_MAIN, {surfaceSources, lavaSources});
 
-    surface = &colata;
+    startup.addTask("surface shader link", [&]()
+    {
+        programs.finish(surfaceShader);
+        surfaceShader.bindUniformBlock("Frame", FRAME_UNIFORMS_BINDING);
+        surfaceShader.use();
+        surfaceShader.setVec3("light.ambient", 0.3f, 0.3f, 0.3f);
+        surfaceShader.setVec3("light.diffuse", 0.8f, 0.8f, 0.8f);
+        surfaceShader.setVec3("light.specular", 1.0f, 1.0f, 1.0f);
+        surfaceShader.setFloat("light.constant", 1.0f);
+        surfaceShader.setFloat("light.linear", 0.00007);
+        surfaceShader.setFloat("light.quadratic", 0.00000035);
+        surfaceShader.setInt("lavaFrame", 1);
+        surfaceShader.setInt("nextLavaFrame", 2);
+    }, TASK_MAIN, {shaderStart}, [&]() { return programs.isReady(surfaceShader); });
+
+    startup.addTask("depth shader link", [&]()
+    {
+        programs.finish(depthShader);
+        depthShader.bindUniformBlock("Frame", FRAME_UNIFORMS_BINDING);
+        depthShader.use();
+        depthShader.setInt("lavaFrame", 1);
+        depthShader.setInt("nextLavaFrame", 2);
+    }, TASK_MAIN, {shaderStart}, [&]() { return programs.isReady(depthShader); });
+
+    startup.addTask("hiz shader link", [&]()
+    {
+        programs.finish(hizShader);
+        hizShader.use();
+        hizShader.setInt("source", 0);
+    }, TASK_MAIN, {shaderStart}, [&]() { return programs.isReady(hizShader); });
+
+    startup.addTask("lava shader link", [&]()
+    {
+        programs.finish(lavaShader);
+        lavaShader.bindUniformBlock("Frame", FRAME_UNIFORMS_BINDING);
+        lavaShader.use();
+        lavaShader.setVec3("light.ambient", 0.3f, 0.3f, 0.3f);
+        lavaShader.setVec3("light.diffuse", 0.8f, 0.8f, 0.8f);
+        lavaShader.setVec3("light.specular", 1.0f, 1.0f, 1.0f);
+        lavaShader.setFloat("light.constant", 1.0f);
+        lavaShader.setFloat("light.linear", 0.00007);
+        lavaShader.setFloat("light.quadratic", 0.00000035);
+    }, TASK_MAIN, {shaderStart}, [&]() { return programs.isReady(lavaShader); });
 
+    LavaOverlay colataLava;
+    Matrix lava;
+    Matrix temperature;
+    if(lavaPlaybackMode)
+    {
+        startup.addTask("lava playback", [&]()
+        {
+            Surface& terrain = *scenes.request(colata)->surface;
+            playback.start(terrain.getRows(), terrain.getColumns());
+            colataLava.offset = colataSettings.maxError;
+        }, TASK_MAIN, {firstUpload});
+    }
+    else if(firstScene == colata)
+    {
+        const int lavaGrid = startup.addTask("lava grid", [&]()
+        {
+            lava.loadFile("./data/lava.dat");
+        });
+        const int temperatureGrid = startup.addTask("temperature grid", [&]()
+        {
+            temperature.loadFile("./data/temperature.dat");
+        });
+        const int overlayMesh = startup.addTask("colata lava overlay", [&]()
+        {
+            //above the highest the terrain can be over the DEM
+            colataLava.offset = colataSettings.maxError;
+            colataLava.build(*scenes.request(colata)->surface, lava, temperature);
+            lava.clear();
+            temperature.clear();
+        }, TASK_WORKER, {firstUpload, lavaGrid, temperatureGrid});
+        startup.addTask("colata lava upload", [&]()
+        {
+            colataLava.upload();
+        }, TASK_MAIN, {overlayMesh});
+    }
+
+    startup.run();
+    startup.printReport();
+
+    glEnable(GL_DEPTH_TEST);
+    if(headlessMode)
+    {
+        //before the target, whose framebuffer stays bound
+        hiz.create(SCR_WIDTH, SCR_HEIGHT);
+        OffscreenTarget target;
+        if(!target.create(SCR_WIDTH, SCR_HEIGHT))
+        {
+            return -1;
+        }
+        Scene* scene = scenes.request(firstScene);
+        surface = scene->surface.get();
+        lod = scene->lod.get();
+
+        //triangles shaded, read after every frame since the frame is finished anyway for timing it. The depth pre-pass
+        //and the occluders are left out, for runs with and without them to compare
+        glGenQueries(1, &shadedTrianglesQuery);
+        BenchmarkStats stats;
+        std::vector<unsigned char> pixels;
+        if(benchmarkFrames == 0)
+        {
+            benchmarkFrames = replayMode ? cameraPath.getDuration() / REPLAY_TIME_STEP + 1 : 300;
+        }
+        //fixed step, and the lava playback waiting for its keyframes, so that every run draws the same frames
+        deltaTime = REPLAY_TIME_STEP;
+        playback.deterministic = true;
+        for(int frame=-BENCHMARK_WARMUP_FRAMES; frame<benchmarkFrames; frame++)
+        {
+            if(replayMode)
+                cameraPath.apply(camera, std::max(frame, 0) * REPLAY_TIME_STEP);
+            else
+                orbitCamera(camera, *surface, std::max(frame, 0) / (float)benchmarkFrames);
+
+            ProfileScope frameScope("frame");
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            glClearColor(0.3f, 0.3f, 0.3f, 1.0f);
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            drawScene(surfaceShader, depthShader, hizShader, lavaShader, firstScene == colata ? &colataLava : NULL, lavaPlaybackMode);
+            glFinish();
+            double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+            unsigned int triangles = 0;
+            glGetQueryObjectuiv(shadedTrianglesQuery, GL_QUERY_RESULT, &triangles);
+            gpuTimer.collect();
+            overdraw.collect();
+            hiz.collect();
+            if(frame < 0)
+            {
+                overdraw.reset();
+                hiz.reset();
+                continue;
+            }
+            stats.addFrame(milliseconds, triangles);
+
+            if(!benchmarkPngDirectory.empty() && frame % benchmarkPngEvery == 0)
+            {
+                char name[32];
+                std::snprintf(name, sizeof(name), "/frame_%04d.png", frame);
+                target.readPixels(pixels);
+                PngWriter::write(benchmarkPngDirectory + name, pixels, target.getWidth(), target.getHeight());
+            }
+        }
+        glDeleteQueries(1, &shadedTrianglesQuery);
+        shadedTrianglesQuery = 0;
+        stats.setOverdraw(depthPrepassMode, overdraw.getFactor());
+        stats.setOcclusion(occlusionCullingMode, hiz.getTestedPerFrame(), hiz.getCulledPerFrame());
+
+        bool written = stats.writeJson(benchmarkJson, benchmarkScene, SCR_WIDTH, SCR_HEIGHT, (const char*)glGetString(GL_RENDERER));
+        if(!profilePath.empty())
+        {
+            Profiler::get().printReport();
+            written = Profiler::get().writeTrace(profilePath) && written;
+        }
+        playback.release();
+        gpuTimer.release();
+        overdraw.release();
+        hiz.release();
+        frameUniforms.release();
+        return written ? 0 : 1;
+    }
+
+    //last scene drawn, kept on screen while the selected one is loading
+    int drawnScene = -1;
+    ViewState drawnView;
+    int windowWidth, windowHeight;
+    glfwGetFramebufferSize(window, &windowWidth, &windowHeight);
+    renderWidth = windowWidth;
+    renderHeight = windowHeight;
+    hiz.create(windowWidth, windowHeight);
+    //a frame per replay step, as the sequences captured along a camera path are meant to be played
+    capture.create(captureDirectory, captureFormat, (int)(1.0f / REPLAY_TIME_STEP + 0.5f));
+    if(captureOnStart)
+        capture.startSequence();
+    if(frameTimeTarget > 0.0f)
+    {
+        if(!resolution.create(windowWidth, windowHeight, frameTimeTarget))
+        {
+            resolution.release();
+            frameTimeTarget = 0.0f;
+        }
+    }
     
     //camera.setMovementSpeed(std::max(surface.getRows(), surface.getColumns()) * surface.getCellSize()/factorTimeSpeedCamera);
 
-    glEnable(GL_DEPTH_TEST);
     while (!glfwWindowShouldClose(window))
     {
-        float currentFrame = glfwGetTime();
+        ProfileScope frameScope("frame");
+        double frameStart = glfwGetTime();
+        float currentFrame = frameStart;
         deltaTime = currentFrame - lastFrame;
         lastFrame = currentFrame;
 
+        ProfileScope inputScope("input");
         processInput(window);
-
-        glClearColor(0.3f, 0.3f, 0.3f, 1.0f);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-        glm::mat4 view = camera.GetViewMatrix();
-        glm::mat4 projection = glm::perspective(glm::radians(45.0f), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 40000.0f);
-
-        surfaceShader.use();
-        surfaceShader.setMat4("projection",projection);
-        surfaceShader.setMat4("view",view);
-        surfaceShader.setVec3("light.position", camera.Position);
-        surfaceShader.setVec3("viewPos", camera.Position);
-
-        glm::mat4 model = glm::mat4();
-        if(wireframeMode)
+        if(recordingMode)
         {
-            glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
+            cameraPath.record(camera, currentFrame - recordingStart);
         }
-        else
+        if(replayMode)
         {
-            glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+            //the time advances by the fixed step instead of the clock, so that every replay draws the same frames
+            deltaTime = REPLAY_TIME_STEP;
+            cameraPath.apply(camera, replayFrame * REPLAY_TIME_STEP);
+            replayFrame++;
+            if(replayFrame * REPLAY_TIME_STEP > cameraPath.getDuration())
+            {
+                std::cout << "Camera path replayed in " << replayFrame << " frames" << std::endl;
+                replayMode = false;
+                playback.deterministic = false;
+                if(captureOnStart)
+                    capture.stopSequence();
+            }
         }
+        inputScope.end();
 
-        if(colataMode)
+        ProfileScope sceneScope("scene update");
+        scenes.update();
+        Scene* scene = scenes.request(selectedScene);
+        if(scene != NULL)
         {
-            surface = &colata;
+            if(drawnScene != selectedScene)
+            {
+                glfwSetWindowTitle(window, scenes.getName(selectedScene).c_str());
+            }
+            drawnScene = selectedScene;
         }
-        else if(curtiMode)
+        else
         {
-            surface = &curti;
+            glfwSetWindowTitle(window, ("Loading " + scenes.getName(selectedScene)).c_str());
+            if(drawnScene != -1)
+            {
+                scene = scenes.request(drawnScene);
+            }
         }
-        else if(albanoMode)
+        sceneScope.end();
+        if(scene == NULL)
         {
-            surface = &albano;
+            glClearColor(0.3f, 0.3f, 0.3f, 1.0f);
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            glfwSwapBuffers(window);
+            frameScope.end();
+            waitForNextFrame(true, frameStart);
+            continue;
         }
+        surface = scene->surface.get();
+        lod = scene->lod.get();
 
-        model = glm::translate(model, glm::vec3(0.0f,-surface->getDropHeight(),0.0f));
-        surfaceShader.setMat4("model",model);
+        bool playbackActive = lavaPlaybackMode && drawnScene == colata;
+        bool animating = movementKeysHeld(window) || (playbackActive && !playback.isSettled()) || replayMode || recordingMode || scenes.isBusy()
+            || capture.isCapturingSequence();
+        bool viewChanged = getViewState(drawnScene) != drawnView;
+        bool dynamicResolutionMode = frameTimeTarget > 0.0f;
+        if(!onDemandMode || animating || redrawRequested || viewChanged || (dynamicResolutionMode && resolution.isReduced()) || occlusionCulledFrame)
+        {
+            occlusionAllowed = !onDemandMode || animating || viewChanged;
+            if(dynamicResolutionMode)
+            {
+                //the frames captured are kept at the window size
+                resolution.begin((!animating && !viewChanged) || capture.isCapturingSequence());
+                renderWidth = resolution.getRenderWidth();
+                renderHeight = resolution.getRenderHeight();
+            }
+            glClearColor(0.3f, 0.3f, 0.3f, 1.0f);
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            drawScene(surfaceShader, depthShader, hizShader, lavaShader, drawnScene == colata ? &colataLava : NULL, playbackActive);
+            if(dynamicResolutionMode)
+                resolution.end();
+            ProfileScope captureScope("capture");
+            int framebufferWidth, framebufferHeight;
+            glfwGetFramebufferSize(window, &framebufferWidth, &framebufferHeight);
+            capture.capture(framebufferWidth, framebufferHeight);
+            captureScope.end();
+            drawnView = getViewState(drawnScene);
+            redrawRequested = false;
 
-        //set camera speed accordingly to the scene
-        camera.setMovementSpeed(std::max(surface->getRows(), surface->getColumns()) * surface->getCellSize()/factorTimeSpeedCamera);
-        glBindVertexArray(surface->VAO); 
-        glBindTexture(GL_TEXTURE_2D, surface->texture);
-        glDrawElements(GL_TRIANGLES, surface->indicesEBO.size(), GL_UNSIGNED_INT, 0);
+            ProfileScope swapScope("swap");
+            glfwSwapBuffers(window);
+        }
+        frameScope.end();
+        gpuTimer.collect();
+        overdraw.collect();
+        hiz.collect();
+        capture.collect();
+        waitForNextFrame(animating, frameStart);
+    }
 
-        glfwSwapBuffers(window);
-        glfwPollEvents();
+    if(recordingMode)
+    {
+        cameraPath.save(CAMERA_PATH_FILE);
+    }
+    if(!profilePath.empty())
+    {
+        Profiler::get().printReport();
+        Profiler::get().writeTrace(profilePath);
     }
+    printOverdraw();
+    printOcclusion();
+    playback.release();
+    gpuTimer.release();
+    overdraw.release();
+    hiz.release();
+    capture.release();
+    frameUniforms.release();
+    if(frameTimeTarget > 0.0f)
+        resolution.release();
 
     glfwTerminate();
     return 0;
@@ -175,32 +744,248 @@ void processInput(GLFWwindow *window)
     if (glfwGetKey(window, GLFW_KEY_K) == GLFW_PRESS)
         wireframeMode=!wireframeMode;
 
+    //toggled once per press, not at every frame the key is held
+    bool frustumCullingKey = glfwGetKey(window, GLFW_KEY_C) == GLFW_PRESS;
+    if (frustumCullingKey && !frustumCullingKeyDown)
+        frustumCullingMode=!frustumCullingMode;
+    frustumCullingKeyDown = frustumCullingKey;
+
+    bool lodKey = glfwGetKey(window, GLFW_KEY_L) == GLFW_PRESS;
+    if (lodKey && !lodKeyDown)
+        lodMode=!lodMode;
+    lodKeyDown = lodKey;
+
+    //one frame per press of the arrows
+    bool playKey = glfwGetKey(window, GLFW_KEY_P) == GLFW_PRESS;
+    if (playKey && !playKeyDown)
+        playback.playing=!playback.playing;
+    playKeyDown = playKey;
+    bool stepForwardKey = glfwGetKey(window, GLFW_KEY_RIGHT) == GLFW_PRESS;
+    if (stepForwardKey && !stepForwardKeyDown)
+        playback.step(1);
+    stepForwardKeyDown = stepForwardKey;
+    bool stepBackKey = glfwGetKey(window, GLFW_KEY_LEFT) == GLFW_PRESS;
+    if (stepBackKey && !stepBackKeyDown)
+        playback.step(-1);
+    stepBackKeyDown = stepBackKey;
+
     if (glfwGetKey(window, GLFW_KEY_1) == GLFW_PRESS)
+        selectedScene=0;
+
+    if (glfwGetKey(window, GLFW_KEY_2) == GLFW_PRESS)
+        selectedScene=1;
+
+    if (glfwGetKey(window, GLFW_KEY_3) == GLFW_PRESS)
+        selectedScene=2;
+
+    //toggled once per press, recording stops any replay
+    bool recordKey = glfwGetKey(window, GLFW_KEY_R) == GLFW_PRESS;
+    if (recordKey && !recordKeyDown)
     {
-        colataMode=true;
-        curtiMode=false;
-        albanoMode=false;
+        recordingMode=!recordingMode;
+        if (recordingMode)
+        {
+            replayMode = false;
+            playback.deterministic = false;
+            cameraPath.clear();
+            recordingStart = lastFrame;
+            std::cout << "Recording camera path" << std::endl;
+        }
+        else
+            cameraPath.save(CAMERA_PATH_FILE);
     }
+    recordKeyDown = recordKey;
 
-    if (glfwGetKey(window, GLFW_KEY_2) == GLFW_PRESS)
+    bool onDemandKey = glfwGetKey(window, GLFW_KEY_O) == GLFW_PRESS;
+    if (onDemandKey && !onDemandKeyDown)
     {
-        colataMode=false;
-        curtiMode=true;
-        albanoMode=false;
+        onDemandMode=!onDemandMode;
+        std::cout << (onDemandMode ? "Rendering on demand" : "Rendering continuously") << std::endl;
     }
+    onDemandKeyDown = onDemandKey;
 
-    if (glfwGetKey(window, GLFW_KEY_3) == GLFW_PRESS)
+    bool depthPrepassKey = glfwGetKey(window, GLFW_KEY_Z) == GLFW_PRESS;
+    if (depthPrepassKey && !depthPrepassKeyDown)
+    {
+        printOverdraw();
+        depthPrepassMode=!depthPrepassMode;
+        redrawRequested = true;
+    }
+    depthPrepassKeyDown = depthPrepassKey;
+
+    bool occlusionCullingKey = glfwGetKey(window, GLFW_KEY_H) == GLFW_PRESS;
+    if (occlusionCullingKey && !occlusionCullingKeyDown)
+    {
+        printOcclusion();
+        occlusionCullingMode=!occlusionCullingMode;
+        redrawRequested = true;
+    }
+    occlusionCullingKeyDown = occlusionCullingKey;
+
+    bool screenshotKey = glfwGetKey(window, GLFW_KEY_F12) == GLFW_PRESS;
+    if (screenshotKey && !screenshotKeyDown)
+    {
+        capture.requestScreenshot();
+        redrawRequested = true;
+    }
+    screenshotKeyDown = screenshotKey;
+
+    bool captureKey = glfwGetKey(window, GLFW_KEY_V) == GLFW_PRESS;
+    if (captureKey && !captureKeyDown)
+    {
+        if (capture.isCapturingSequence())
+            capture.stopSequence();
+        else
+            capture.startSequence();
+    }
+    captureKeyDown = captureKey;
+}
+
+//Shaded fragments per pixel of the terrain over the frames since the last call
+void printOverdraw()
+{
+    overdraw.collect();
+    if(overdraw.getFrames() > 0)
+    {
+        std::cout << "Shaded fragments per pixel " << (depthPrepassMode ? "with" : "without") << " depth pre-pass: "
+            << overdraw.getFactor() << ", over " << overdraw.getFrames() << " frames" << std::endl;
+    }
+    overdraw.reset();
+}
+
+//Chunks left out by the occlusion culling over the frames since the last call
+void printOcclusion()
+{
+    if(hiz.getFrames() > 0)
+    {
+        std::cout << "Occlusion culling left out " << hiz.getCulledPerFrame() << " of " << hiz.getTestedPerFrame()
+            << " chunks tested per frame, over " << hiz.getFrames() << " frames" << std::endl;
+    }
+    hiz.reset();
+}
+
+//Keys moving the camera for as long as they are held, so frames must follow each other without waiting for events
+// writes the frames numbered from 0 in a lava series, then reads it back and compares the sizes and the load times
+// ---------------------------------------------------------------------------------------------------------
+bool convertLavaFrames(const char* framePattern, const char* seriesPath, const unsigned int keyframeInterval)
+{
+    char path[1024];
+    std::snprintf(path, sizeof(path), framePattern, 0);
+    Matrix frame(path);
+    if(!frame.isLoaded())
+    {
+        std::cout << "No frames to convert at path: " << path << std::endl;
+        return false;
+    }
+
+    int numberOfFrames = 0;
+    unsigned long long framesBytes = 0;
+    double framesMs = 0.0;
+    {
+        LavaSeriesWriter writer(seriesPath, frame.getRows(), frame.getColumns(), frame.getCellSize(), frame.getNoDataValue(), keyframeInterval);
+        while(true)
+        {
+            std::snprintf(path, sizeof(path), framePattern, numberOfFrames);
+            std::ifstream file(path, std::ios::binary | std::ios::ate);
+            if(!file.good())
+                break;
+            framesBytes += (unsigned long long)file.tellg();
+
+            auto start = std::chrono::steady_clock::now();
+            frame.clear();
+            frame.loadFile(path);
+            framesMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            writer.addFrame(frame);
+            numberOfFrames++;
+        }
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    LavaSeriesReader reader(seriesPath);
+    if(!reader.isValid() || reader.getNumberOfFrames() != numberOfFrames)
+    {
+        std::cout << "Lava series not readable after writing at path: " << seriesPath << std::endl;
+        return false;
+    }
+    for(int i=0; i<numberOfFrames; i++)
+        reader.readFrame(i);
+    const double seriesMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    std::ifstream series(seriesPath, std::ios::binary | std::ios::ate);
+
+    std::cout << seriesPath << ": " << numberOfFrames << " frames, " << framesBytes << " bytes loaded in " << framesMs << " ms as frames, "
+        << (unsigned long long)series.tellg() << " bytes loaded in " << seriesMs << " ms as series" << std::endl;
+    return true;
+}
+
+bool movementKeysHeld(GLFWwindow* window)
+{
+    return glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS || glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS
+        || glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS || glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS;
+}
+
+//Takes the events for the next frame: polled right away while animating or drawing continuously, after the rest of the
+//frame time if capped, otherwise waited for
+void waitForNextFrame(bool animating, double frameStart)
+{
+    if(!onDemandMode || animating)
     {
-        colataMode=false;
-        curtiMode=false;
-        albanoMode=true;
+        if(maxFps > 0.0f)
+        {
+            double remaining = frameStart + 1.0 / maxFps - glfwGetTime();
+            if(remaining > 0.0)
+                std::this_thread::sleep_for(std::chrono::duration<double>(remaining));
+        }
+        glfwPollEvents();
+    }
+    else
+    {
+        glfwWaitEventsTimeout(ON_DEMAND_IDLE_TIMEOUT);
+        //the time spent waiting is not a frame, the camera must not jump by it
+        lastFrame = glfwGetTime();
     }
 }
 
+ViewState getViewState(int scene)
+{
+    ViewState state;
+    state.position = camera.Position;
+    state.yaw = camera.Yaw;
+    state.pitch = camera.Pitch;
+    state.zoom = camera.Zoom;
+    state.scene = scene;
+    state.wireframe = wireframeMode;
+    state.frustumCulling = frustumCullingMode;
+    state.lod = lodMode;
+    state.lavaFrame = lavaPlaybackMode ? playback.getDisplayedFrame() : -1;
+    state.lavaBlend = lavaPlaybackMode ? playback.getBlend() : 0.0f;
+    return state;
+}
+
 
 void framebuffer_size_callback(GLFWwindow *window, int width, int height)
 {
     glViewport(0, 0, width, height);
+    //a minimized window has no pixels, the targets keep their size until it comes back
+    if(width <= 0 || height <= 0)
+    {
+        return;
+    }
+    hiz.resize(width, height);
+    if(frameTimeTarget > 0.0f)
+    {
+        resolution.resize(width, height);
+    }
+    else
+    {
+        renderWidth = width;
+        renderHeight = height;
+    }
+    redrawRequested = true;
+}
+
+void refresh_callback(GLFWwindow* window)
+{
+    redrawRequested = true;
 }
 
 
@@ -228,6 +1013,206 @@ void scroll_callback(GLFWwindow* window, double xoffset, double yoffset)
     camera.ProcessMouseScroll(yoffset);
 }
 
+//Draws the current surface from the camera with the current modes, then the lava overlay over it if given
+void drawScene(Shader& surfaceShader, Shader& depthShader, Shader& hizShader, Shader& lavaShader, LavaOverlay* lavaOverlay, bool playbackActive)
+{
+    ProfileScope uniformsScope("uniforms");
+    glm::mat4 view = camera.GetViewMatrix();
+    glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float)renderWidth / (float)renderHeight, 0.1f, 40000.0f);
+
+    FrameUniforms frame;
+    frame.projection = projection;
+    frame.view = view;
+    frame.viewPosition = glm::vec4(camera.Position, 1.0f);
+    frame.lightPosition = glm::vec4(camera.Position, 1.0f);
+    frameUniforms.update(frame);
+
+    surfaceShader.use();
+
+    glm::mat4 model = glm::mat4();
+    if(wireframeMode)
+    {
+        glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
+    }
+    else
+    {
+        glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+    }
+
+    model = glm::translate(model, glm::vec3(0.0f,-surface->getDropHeight(),0.0f));
+    surfaceShader.setMat4("model",model);
+    surfaceShader.setVec2("temperatureRange", surface->getTemperatureRange());
+
+    //in overlay mode the terrain stays static and the overlay follows the keyframe before the playhead
+    if(playbackActive)
+    {
+        playback.update(deltaTime);
+    }
+    if(playbackActive && lavaOverlayMode)
+    {
+        if(lavaOverlay != NULL && playback.getDisplayedFrame() != -1 && playback.getDisplayedFrame() != lavaOverlay->getFrame())
+        {
+            ProfileScope overlayScope("lava overlay update");
+            lavaOverlay->update(*surface, playback.getCells(), playback.getDisplayedFrame());
+            lavaOverlay->upload();
+        }
+        playbackActive = false;
+    }
+    surfaceShader.setBool("lavaPlayback", playbackActive);
+    if(playbackActive)
+    {
+        surfaceShader.setFloat("cellSize", surface->getCellSize());
+        surfaceShader.setFloat("lavaBlend", playback.getBlend());
+        glActiveTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_2D, playback.getTexture());
+        glActiveTexture(GL_TEXTURE2);
+        glBindTexture(GL_TEXTURE_2D, playback.getNextTexture());
+        glActiveTexture(GL_TEXTURE0);
+    }
+
+    //set camera speed accordingly to the scene
+    camera.setMovementSpeed(std::max(surface->getRows(), surface->getColumns()) * surface->getCellSize()/factorTimeSpeedCamera);
+    uniformsScope.end();
+
+    ProfileScope terrainScope("terrain submission");
+    TerrainDraw draw = buildTerrainDraws(projection * view * model, playbackActive);
+    glBindTexture(GL_TEXTURE_2D, surface->texture);
+    //lines leave most pixels uncovered, a pre-pass would not save anything, nor would the chunks behind them hide
+    bool prepass = depthPrepassMode && !wireframeMode;
+    bool occluders = occlusionCullingMode && !wireframeMode && draw != DRAW_ALL;
+    if(prepass || occluders)
+    {
+        depthShader.use();
+        depthShader.setMat4("model", model);
+        depthShader.setBool("lavaPlayback", playbackActive);
+        if(playbackActive)
+        {
+            depthShader.setFloat("cellSize", surface->getCellSize());
+            depthShader.setFloat("lavaBlend", playback.getBlend());
+        }
+    }
+    if(prepass)
+    {
+        gpuTimer.begin("depth prepass");
+        glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+        submitTerrain(draw);
+        glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+        //surface.vs has an invariant position, the shading pass finds the same depths
+        glDepthFunc(GL_EQUAL);
+        glDepthMask(GL_FALSE);
+        gpuTimer.end();
+    }
+    surfaceShader.use();
+
+    gpuTimer.begin("terrain");
+    overdraw.begin();
+    if(shadedTrianglesQuery != 0)
+        glBeginQuery(GL_PRIMITIVES_GENERATED, shadedTrianglesQuery);
+    submitTerrain(draw);
+    if(shadedTrianglesQuery != 0)
+        glEndQuery(GL_PRIMITIVES_GENERATED);
+    overdraw.end((double)renderWidth * renderHeight);
+    gpuTimer.end();
+    if(prepass)
+    {
+        glDepthFunc(GL_LESS);
+        glDepthMask(GL_TRUE);
+    }
+
+    //the nearest chunks drawn, for the depth pyramid the next frames are culled with
+    if(occluders)
+    {
+        gpuTimer.begin("occluders");
+        depthShader.use();
+        hiz.beginOccluders(surface, projection * view * model);
+        submitTerrain(draw, HIZ_OCCLUDER_DRAWS);
+        hiz.endOccluders(hizShader);
+        gpuTimer.end();
+    }
+    terrainScope.end();
+
+    if(lavaOverlay != NULL && lavaOverlay->getNumberOfCells() > 0)
+    {
+        ProfileScope lavaScope("lava submission");
+        gpuTimer.begin("lava");
+        lavaShader.use();
+        lavaShader.setMat4("model",model);
+        lavaShader.setVec2("temperatureRange", lavaOverlay->getTemperatureRange());
+        lavaOverlay->draw();
+        gpuTimer.end();
+    }
+}
+
+
+//Fills the draw lists of the current surface for the current modes, the chunks in front first. A surface with strips
+//has no other index buffer, nor levels of detail. The coarse levels are not used under the lava playback either, whose
+//lava is sampled at the vertices of the surface
+TerrainDraw buildTerrainDraws(const glm::mat4& viewProjectionModel, bool lavaPlayback)
+{
+    //the surface is translated down by its drop height, move the camera in its space
+    glm::vec3 cameraPosition = camera.Position + glm::vec3(0.0f, surface->getDropHeight(), 0.0f);
+    bool strips = surface->hasStrips();
+    bool coarse = lodMode && !lavaPlayback;
+    bool chunked = strips || coarse || frustumCullingMode;
+    HiZCuller* occlusion = occlusionCullingMode && occlusionAllowed && !wireframeMode && chunked ? hiz.forSurface(surface) : NULL;
+    occlusionCulledFrame = occlusion != NULL;
+    if(strips)
+    {
+        frustum.update(viewProjectionModel);
+        surface->buildStripDrawList(frustum, cameraPosition, shortStripDraws, wideStripDraws, occlusion);
+        return DRAW_STRIPS;
+    }
+    else if(coarse)
+    {
+        frustum.update(viewProjectionModel);
+        lod->select(cameraPosition, glm::radians(camera.Zoom), renderHeight, frustum, drawCounts, drawOffsets, occlusion);
+        return DRAW_LOD;
+    }
+    else if(frustumCullingMode)
+    {
+        frustum.update(viewProjectionModel);
+        surface->buildDrawList(frustum, cameraPosition, drawCounts, drawOffsets, occlusion);
+        return DRAW_CULLED;
+    }
+    occlusionCulledFrame = false;
+    return DRAW_ALL;
+}
+
+//Draws the terrain from the lists of buildTerrainDraws with the program in use, at most its nearest maxDraws draws
+void submitTerrain(TerrainDraw draw, unsigned int maxDraws)
+{
+    glBindVertexArray(surface->VAO);
+    if(draw == DRAW_LOD || draw == DRAW_CULLED)
+    {
+        glMultiDrawElements(GL_TRIANGLES, drawCounts.data(), GL_UNSIGNED_INT, drawOffsets.data(), std::min<size_t>(drawCounts.size(), maxDraws));
+    }
+    else if(draw == DRAW_STRIPS)
+    {
+        glBindVertexArray(surface->stripVAO);
+        glEnable(GL_PRIMITIVE_RESTART);
+        glPrimitiveRestartIndex(STRIP_RESTART_SHORT);
+        //the nearest maxDraws chunks of the two lists together
+        glMultiDrawElementsBaseVertex(GL_TRIANGLE_STRIP, shortStripDraws.counts.data(), GL_UNSIGNED_SHORT, shortStripDraws.offsets.data(), shortStripDraws.countNearest(maxDraws), shortStripDraws.baseVertices.data());
+        glPrimitiveRestartIndex(STRIP_RESTART_WIDE);
+        glMultiDrawElementsBaseVertex(GL_TRIANGLE_STRIP, wideStripDraws.counts.data(), GL_UNSIGNED_INT, wideStripDraws.offsets.data(), wideStripDraws.countNearest(maxDraws), wideStripDraws.baseVertices.data());
+        glDisable(GL_PRIMITIVE_RESTART);
+    }
+    else
+    {
+        glDrawElements(GL_TRIANGLES, surface->getIndexCount(), GL_UNSIGNED_INT, 0);
+    }
+}
+
+//Creates the vertex arrays of a surface loaded by the scene manager, whose buffers are then filled by Surface::uploadSlice
+void uploadSurface(Surface& surface)
+{
+    surface.VAO = loadVAO(surface.vertices.size(), NULL, surface.indicesEBO.size(), NULL);
+    if(surface.hasStrips())
+    {
+        surface.stripVAO = loadStripVAO(surface.VAO, surface.stripIndicesWide.size(), surface.stripIndicesShort.size());
+    }
+}
+
 unsigned int loadVAO(unsigned int sizeVertices, glm::vec3* firstVertex, unsigned int sizeEBO, unsigned int* firstEBO)
 {
     unsigned int VAO, VBO, EBO;
@@ -242,6 +1227,36 @@ unsigned int loadVAO(unsigned int sizeVertices, glm::vec3* firstVertex, unsigned
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
     glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(unsigned int) * sizeEBO, firstEBO, GL_STATIC_DRAW);
 
+    setVertexAttributes();
+
+    return VAO;
+}
+
+//Second VAO over the vertex buffer of VAO, drawing the triangle strips: wide indices first, then the short ones.
+//The index buffer is left empty, for Surface::uploadSlice to fill
+unsigned int loadStripVAO(unsigned int VAO, unsigned int sizeWide, unsigned int sizeShort)
+{
+    GLint VBO;
+    glBindVertexArray(VAO);
+    glGetVertexAttribiv(0, GL_VERTEX_ATTRIB_ARRAY_BUFFER_BINDING, &VBO);
+
+    unsigned int stripVAO, EBO;
+    glGenVertexArrays(1, &stripVAO);
+    glGenBuffers(1, &EBO);
+    glBindVertexArray(stripVAO);
+
+    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(unsigned int) * sizeWide + sizeof(unsigned short) * sizeShort, NULL, GL_STATIC_DRAW);
+
+    setVertexAttributes();
+
+    return stripVAO;
+}
+
+void setVertexAttributes()
+{
     //Position attribute
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 12 * sizeof(GLfloat), (GLvoid*)0);
     glEnableVertexAttribArray(0);
@@ -257,6 +1272,4 @@ unsigned int loadVAO(unsigned int sizeVertices, glm::vec3* firstVertex, unsigned
     //Texture coordinate
     glVertexAttribPointer(3, 2, GL_FLOAT, GL_FALSE, 12 * sizeof(GLfloat), (GLvoid*) ( 9 * sizeof(GLfloat) ));
     glEnableVertexAttribArray(3);
-
-    return VAO;
 }
\ No newline at end of file
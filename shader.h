@@ -7,6 +7,8 @@
 #include <glm/glm.hpp>
 
 #include <string>
+#include <vector>
+#include <unordered_map>
 #include <fstream>
 #include <sstream>
 #include <iostream>
@@ -15,88 +17,144 @@ class Shader
 {
 public:
     unsigned int ID;
+    Shader() : ID(0)
+    {
+    }
     // constructor generates the shader on the fly
     // ------------------------------------------------------------------------
     Shader(const char* vertexPath, const char* fragmentPath, const char* geometryPath = nullptr)
     {
         // 1. retrieve the vertex/fragment source code from filePath
-        std::string vertexCode;
-        std::string fragmentCode;
-        std::string geometryCode;
-        std::ifstream vShaderFile;
-        std::ifstream fShaderFile;
-        std::ifstream gShaderFile;
+        std::string vertexCode = readFile(vertexPath);
+        std::string fragmentCode = readFile(fragmentPath);
+        // if geometry shader path is present, also load a geometry shader
+        std::string geometryCode = geometryPath != nullptr ? readFile(geometryPath) : "";
+        // 2. compile shaders
+        compile(vertexCode, fragmentCode, geometryCode);
+    }
+    // reads the source of a shader, with no GL calls so that it can run on another thread
+    // ------------------------------------------------------------------------
+    static std::string readFile(const char* path)
+    {
+        std::ifstream shaderFile;
         // ensure ifstream objects can throw exceptions:
-        vShaderFile.exceptions (std::ifstream::failbit | std::ifstream::badbit);
-        fShaderFile.exceptions (std::ifstream::failbit | std::ifstream::badbit);
-        gShaderFile.exceptions (std::ifstream::failbit | std::ifstream::badbit);
+        shaderFile.exceptions (std::ifstream::failbit | std::ifstream::badbit);
         try 
         {
-            // open files
-            vShaderFile.open(vertexPath);
-            fShaderFile.open(fragmentPath);
-            std::stringstream vShaderStream, fShaderStream;
+            shaderFile.open(path);
+            std::stringstream shaderStream;
             // read file's buffer contents into streams
-            vShaderStream << vShaderFile.rdbuf();
-            fShaderStream << fShaderFile.rdbuf();		
-            // close file handlers
-            vShaderFile.close();
-            fShaderFile.close();
-            // convert stream into string
-            vertexCode = vShaderStream.str();
-            fragmentCode = fShaderStream.str();			
-            // if geometry shader path is present, also load a geometry shader
-            if(geometryPath != nullptr)
-            {
-                gShaderFile.open(geometryPath);
-                std::stringstream gShaderStream;
-                gShaderStream << gShaderFile.rdbuf();
-                gShaderFile.close();
-                geometryCode = gShaderStream.str();
-            }
+            shaderStream << shaderFile.rdbuf();
+            shaderFile.close();
+            return shaderStream.str();
         }
         catch (std::ifstream::failure e)
         {
             std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ" << std::endl;
         }
+        return "";
+    }
+    // compiles and links sources already read, an empty geometry source leaves the geometry shader out
+    // ------------------------------------------------------------------------
+    void compile(const std::string& vertexCode, const std::string& fragmentCode, const std::string& geometryCode = "")
+    {
+        startCompile(vertexCode, fragmentCode, geometryCode);
+        finishCompile();
+    }
+    // compile split in two: drivers with KHR_parallel_shader_compile build the programs started before finishing any
+    // of them at the same time, others as they are started. A retrievable program can be saved with getBinary
+    // ------------------------------------------------------------------------
+    void startCompile(const std::string& vertexCode, const std::string& fragmentCode, const std::string& geometryCode = "", bool retrievable = false)
+    {
         const char* vShaderCode = vertexCode.c_str();
         const char * fShaderCode = fragmentCode.c_str();
-        // 2. compile shaders
         unsigned int vertex, fragment;
         // vertex shader
         vertex = glCreateShader(GL_VERTEX_SHADER);
         glShaderSource(vertex, 1, &vShaderCode, NULL);
         glCompileShader(vertex);
-        checkCompileErrors(vertex, "VERTEX");
         // fragment Shader
         fragment = glCreateShader(GL_FRAGMENT_SHADER);
         glShaderSource(fragment, 1, &fShaderCode, NULL);
         glCompileShader(fragment);
-        checkCompileErrors(fragment, "FRAGMENT");
+        pendingShaders.clear();
+        pendingShaders.push_back(vertex);
+        pendingShaders.push_back(fragment);
         // if geometry shader is given, compile geometry shader
-        unsigned int geometry;
-        if(geometryPath != nullptr)
+        if(!geometryCode.empty())
         {
             const char * gShaderCode = geometryCode.c_str();
-            geometry = glCreateShader(GL_GEOMETRY_SHADER);
+            unsigned int geometry = glCreateShader(GL_GEOMETRY_SHADER);
             glShaderSource(geometry, 1, &gShaderCode, NULL);
             glCompileShader(geometry);
-            checkCompileErrors(geometry, "GEOMETRY");
+            pendingShaders.push_back(geometry);
         }
         // shader Program
         ID = glCreateProgram();
-        glAttachShader(ID, vertex);
-        glAttachShader(ID, fragment);
-        if(geometryPath != nullptr)
-            glAttachShader(ID, geometry);
+        if(retrievable)
+            glProgramParameteri(ID, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+        for(unsigned int i = 0; i < pendingShaders.size(); i++)
+            glAttachShader(ID, pendingShaders[i]);
         glLinkProgram(ID);
-        checkCompileErrors(ID, "PROGRAM");
+    }
+    // waits for the program started by startCompile, false if it did not compile or link
+    // ------------------------------------------------------------------------
+    bool finishCompile()
+    {
+        const char* types[] = {"VERTEX", "FRAGMENT", "GEOMETRY"};
+        bool success = true;
+        for(unsigned int i = 0; i < pendingShaders.size(); i++)
+            success = checkCompileErrors(pendingShaders[i], types[i]) && success;
+        success = checkCompileErrors(ID, "PROGRAM") && success;
         // delete the shaders as they're linked into our program now and no longer necessery
-        glDeleteShader(vertex);
-        glDeleteShader(fragment);
-        if(geometryPath != nullptr)
-            glDeleteShader(geometry);
-
+        for(unsigned int i = 0; i < pendingShaders.size(); i++)
+            glDeleteShader(pendingShaders[i]);
+        pendingShaders.clear();
+        cacheUniformLocations();
+        return success;
+    }
+    // the source with lines of #define after its #version line, for building variants of a shader
+    // ------------------------------------------------------------------------
+    static std::string addDefines(const std::string& code, const std::string& defines)
+    {
+        if(defines.empty())
+            return code;
+        std::string::size_type version = code.find("#version");
+        std::string::size_type lineEnd = version == std::string::npos ? std::string::npos : code.find('\n', version);
+        if(lineEnd == std::string::npos)
+            return defines + "\n" + code;
+        return code.substr(0, lineEnd + 1) + defines + "\n" + code.substr(lineEnd + 1);
+    }
+    // links the program from a binary returned by getBinary, false if the driver does not take it anymore
+    // ------------------------------------------------------------------------
+    bool loadBinary(GLenum format, const std::vector<char>& binary)
+    {
+        ID = glCreateProgram();
+        glProgramBinary(ID, format, binary.data(), binary.size());
+        GLint success = 0;
+        glGetProgramiv(ID, GL_LINK_STATUS, &success);
+        if(!success)
+        {
+            glDeleteProgram(ID);
+            ID = 0;
+            return false;
+        }
+        cacheUniformLocations();
+        return true;
+    }
+    // the linked program as the driver stores it, for loadBinary on the next launches
+    // ------------------------------------------------------------------------
+    bool getBinary(GLenum& format, std::vector<char>& binary)
+    {
+        GLint length = 0;
+        glGetProgramiv(ID, GL_PROGRAM_BINARY_LENGTH, &length);
+        if(length <= 0)
+            return false;
+        binary.resize(length);
+        GLsizei written = 0;
+        glGetProgramBinary(ID, length, &written, &format, binary.data());
+        binary.resize(written);
+        return written > 0;
     }
     // activate the shader
     // ------------------------------------------------------------------------
@@ -104,69 +162,122 @@ public:
     { 
         glUseProgram(ID); 
     }
+    // location read at link time, -1 for names not in the program, which glUniform ignores
+    // ------------------------------------------------------------------------
+    GLint getUniformLocation(const std::string &name) const
+    {
+        std::unordered_map<std::string, GLint>::const_iterator location = uniformLocations.find(name);
+        return location == uniformLocations.end() ? -1 : location->second;
+    }
+    // maps the uniform block of the program named name to a binding point of the uniform buffers
+    // ------------------------------------------------------------------------
+    void bindUniformBlock(const std::string &name, unsigned int binding) const
+    {
+        unsigned int index = glGetUniformBlockIndex(ID, name.c_str());
+        if(index != GL_INVALID_INDEX)
+            glUniformBlockBinding(ID, index, binding);
+    }
     // utility uniform functions
     // ------------------------------------------------------------------------
     void setBool(const std::string &name, bool value) const
     {         
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value); 
+        glUniform1i(getUniformLocation(name), (int)value); 
     }
     // ------------------------------------------------------------------------
     void setInt(const std::string &name, int value) const
     { 
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), value); 
+        glUniform1i(getUniformLocation(name), value); 
     }
     // ------------------------------------------------------------------------
     void setFloat(const std::string &name, float value) const
     { 
-        glUniform1f(glGetUniformLocation(ID, name.c_str()), value); 
+        glUniform1f(getUniformLocation(name), value); 
     }
     // ------------------------------------------------------------------------
     void setVec2(const std::string &name, const glm::vec2 &value) const
     { 
-        glUniform2fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]); 
+        glUniform2fv(getUniformLocation(name), 1, &value[0]); 
     }
     void setVec2(const std::string &name, float x, float y) const
     { 
-        glUniform2f(glGetUniformLocation(ID, name.c_str()), x, y); 
+        glUniform2f(getUniformLocation(name), x, y); 
     }
     // ------------------------------------------------------------------------
     void setVec3(const std::string &name, const glm::vec3 &value) const
     { 
-        glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]); 
+        glUniform3fv(getUniformLocation(name), 1, &value[0]); 
     }
     void setVec3(const std::string &name, float x, float y, float z) const
     { 
-        glUniform3f(glGetUniformLocation(ID, name.c_str()), x, y, z); 
+        glUniform3f(getUniformLocation(name), x, y, z); 
     }
     // ------------------------------------------------------------------------
     void setVec4(const std::string &name, const glm::vec4 &value) const
     { 
-        glUniform4fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]); 
+        glUniform4fv(getUniformLocation(name), 1, &value[0]); 
     }
     void setVec4(const std::string &name, float x, float y, float z, float w) 
     { 
-        glUniform4f(glGetUniformLocation(ID, name.c_str()), x, y, z, w); 
+        glUniform4f(getUniformLocation(name), x, y, z, w); 
     }
     // ------------------------------------------------------------------------
     void setMat2(const std::string &name, const glm::mat2 &mat) const
     {
-        glUniformMatrix2fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        glUniformMatrix2fv(getUniformLocation(name), 1, GL_FALSE, &mat[0][0]);
     }
     // ------------------------------------------------------------------------
     void setMat3(const std::string &name, const glm::mat3 &mat) const
     {
-        glUniformMatrix3fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        glUniformMatrix3fv(getUniformLocation(name), 1, GL_FALSE, &mat[0][0]);
     }
     // ------------------------------------------------------------------------
     void setMat4(const std::string &name, const glm::mat4 &mat) const
     {
-        glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        glUniformMatrix4fv(getUniformLocation(name), 1, GL_FALSE, &mat[0][0]);
     }
 
 private:
-    // utility function for checking shader compilation/linking errors.
+    std::unordered_map<std::string, GLint> uniformLocations;
+    // compiled by startCompile, attached until finishCompile
+    std::vector<unsigned int> pendingShaders;
+
+    // reads the location of every active uniform, so that the setters never ask the driver. Arrays are reported as
+    // name[0]: every element is added, and the array name for the first one. Members of uniform blocks have none
+    // ------------------------------------------------------------------------
+    void cacheUniformLocations()
+    {
+        uniformLocations.clear();
+        GLint count = 0, maxLength = 0;
+        glGetProgramiv(ID, GL_ACTIVE_UNIFORMS, &count);
+        glGetProgramiv(ID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+        std::vector<GLchar> buffer(maxLength + 1);
+        for(GLint i = 0; i < count; i++)
+        {
+            GLsizei length = 0;
+            GLint size = 0;
+            GLenum type;
+            glGetActiveUniform(ID, i, buffer.size(), &length, &size, &type, &buffer[0]);
+            std::string name(&buffer[0], length);
+            GLint location = glGetUniformLocation(ID, name.c_str());
+            if(location == -1)
+                continue;
+            uniformLocations[name] = location;
+            if(name.size() > 3 && name.compare(name.size() - 3, 3, "[0]") == 0)
+            {
+                std::string array = name.substr(0, name.size() - 3);
+                uniformLocations[array] = location;
+                for(GLint element = 1; element < size; element++)
+                {
+                    std::string elementName = array + "[" + std::to_string(element) + "]";
+                    uniformLocations[elementName] = glGetUniformLocation(ID, elementName.c_str());
+                }
+            }
+        }
+    }
+
+    // utility function for checking shader compilation/linking errors, false on errors.
     // ------------------------------------------------------------------------
-    void checkCompileErrors(GLuint shader, std::string type)
+    bool checkCompileErrors(GLuint shader, std::string type)
     {
         GLint success;
         GLchar infoLog[1024];
@@ -188,6 +299,7 @@ private:
                 std::cout << "ERROR::PROGRAM_LINKING_ERROR of type: " << type << "\n" << infoLog << "\n -- --------------------------------------------------- -- " << std::endl;
             }
         }
+        return success;
     }
 };
 #endif
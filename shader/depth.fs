@@ -0,0 +1,6 @@
+#version 330 core
+
+// depth pre-pass of the terrain, placed by surface.vs: only the depth is written, the colors are masked
+void main()
+{
+}
@@ -0,0 +1,24 @@
+#version 330 core
+
+// one level of the depth pyramid of HiZCuller: the farthest of the 2x2 texels under it in the level before, the only one
+// the sampler sees. Levels are halved rounding down, so the last texels of an odd sized level take its extra row or column
+uniform sampler2D source;
+
+out float depth;
+
+void main()
+{
+    ivec2 sourceSize = textureSize(source, 0);
+    ivec2 texel = ivec2(gl_FragCoord.xy) * 2;
+    int columns = texel.x + 2 == sourceSize.x - 1 ? 3 : 2;
+    int rows = texel.y + 2 == sourceSize.y - 1 ? 3 : 2;
+    float farthest = 0.0;
+    for (int y = 0; y < rows; y++)
+    {
+        for (int x = 0; x < columns; x++)
+        {
+            farthest = max(farthest, texelFetch(source, min(texel + ivec2(x, y), sourceSize - 1), 0).r);
+        }
+    }
+    depth = farthest;
+}
@@ -0,0 +1,58 @@
+#version 330 core
+
+struct Light {
+    vec3 ambient;
+    vec3 diffuse;
+    vec3 specular;
+
+    float constant;
+    float linear;
+    float quadratic;
+};
+
+in vec3 FragPos;
+in vec3 Normal;
+in float Temperature;
+
+out vec4 color;
+
+// camera and light of the frame, shared by every program: FrameUniforms in main.cpp has the same std140 layout
+layout (std140) uniform Frame
+{
+    mat4 projection;
+    mat4 view;
+    vec4 viewPos;
+    vec4 lightPosition;
+};
+
+uniform Light light;
+
+void main()
+{
+    vec3 aColor = vec3(1.0f, Temperature, 0.0f);
+
+    // Ambient
+    vec3 ambient = light.ambient * aColor;
+
+   // Diffuse
+    vec3 norm = normalize(Normal);
+    vec3 lightDir = normalize(lightPosition.xyz - FragPos);
+    float diff = max(dot(norm, lightDir), 0.0);
+    vec3 diffuse = light.diffuse * diff * aColor;
+
+    // Specular
+    vec3 viewDir = normalize(viewPos.xyz - FragPos);
+    vec3 reflectDir = reflect(-lightDir, norm);
+    float spec = pow(max(dot(viewDir, reflectDir), 0.0), 32);
+    vec3 specular = light.specular * spec * aColor;
+
+    // Attenuation
+    float distance    = length(lightPosition.xyz - FragPos);
+    float attenuation = 1.0f / (light.constant + light.linear * distance + light.quadratic * (distance * distance));
+
+    //ambient  *= attenuation;
+    //diffuse  *= attenuation;
+    //specular *= attenuation;
+
+    color = vec4(ambient + diffuse + specular, 1.0f);
+}
@@ -0,0 +1,31 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aNormal;
+layout (location = 2) in float aTemperature;
+
+out vec3 FragPos;
+out vec3 Normal;
+out float Temperature;
+
+// camera and light of the frame, shared by every program: FrameUniforms in main.cpp has the same std140 layout
+layout (std140) uniform Frame
+{
+    mat4 projection;
+    mat4 view;
+    vec4 viewPos;
+    vec4 lightPosition;
+};
+
+uniform mat4 model;
+
+// temperatures of the vertices mapped to 0 and 1
+uniform vec2 temperatureRange;
+
+void main()
+{
+    FragPos = vec3(model * vec4(aPos, 1.0f));
+    Normal = mat3(transpose(inverse(model))) * aNormal;
+    Temperature = clamp((aTemperature - temperatureRange.x) / (temperatureRange.y - temperatureRange.x), 0.0f, 1.0f);
+
+    gl_Position = projection * view * model * vec4(aPos, 1.0);
+}
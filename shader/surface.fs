@@ -1,8 +1,6 @@
 #version 330 core
 
 struct Light {
-    vec3 position;
-
     vec3 ambient;
     vec3 diffuse;
     vec3 specular;
@@ -19,14 +17,22 @@ in vec2 TexCoord;
 
 out vec4 color;
 
-uniform vec3 viewPos;
+// camera and light of the frame, shared by every program: FrameUniforms in main.cpp has the same std140 layout
+layout (std140) uniform Frame
+{
+    mat4 projection;
+    mat4 view;
+    vec4 viewPos;
+    vec4 lightPosition;
+};
+
 uniform Light light;
 uniform sampler2D texture1;
 
 void main()
 {
     vec3 aColor;
-    if (RedValue == 0.0f)
+    if (RedValue.x == 0.0f)
     {
         aColor = vec3(texture(texture1, TexCoord).rgb) * vec3(1.0f);
     }
@@ -40,18 +46,18 @@ void main()
 
    // Diffuse
     vec3 norm = normalize(Normal);
-    vec3 lightDir = normalize(light.position - FragPos);
+    vec3 lightDir = normalize(lightPosition.xyz - FragPos);
     float diff = max(dot(norm, lightDir), 0.0);
     vec3 diffuse = light.diffuse * diff * aColor;
 
     // Specular
-    vec3 viewDir = normalize(viewPos - FragPos);
+    vec3 viewDir = normalize(viewPos.xyz - FragPos);
     vec3 reflectDir = reflect(-lightDir, norm);
     float spec = pow(max(dot(viewDir, reflectDir), 0.0), 32);
     vec3 specular = light.specular * spec * aColor;
 
     // Attenuation
-    float distance    = length(light.position - FragPos);
+    float distance    = length(lightPosition.xyz - FragPos);
     float attenuation = 1.0f / (light.constant + light.linear * distance + light.quadratic * (distance * distance));
 
     //ambient  *= attenuation;
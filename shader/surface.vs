@@ -9,18 +9,62 @@ out vec3 Normal;
 out vec3 RedValue;
 out vec2 TexCoord;
 
+// camera and light of the frame, shared by every program: FrameUniforms in main.cpp has the same std140 layout
+layout (std140) uniform Frame
+{
+    mat4 projection;
+    mat4 view;
+    vec4 viewPos;
+    vec4 lightPosition;
+};
+
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+
+// the same in the depth pre-pass, whose depths the shading pass must find equal
+invariant gl_Position;
+
+// temperatures of the vertices mapped to 0 and 1, 0 is left for the cells without lava
+uniform vec2 temperatureRange;
+
+// lava playback: thickness in R and normalized temperature in G, one texel per cell,
+// blended between the keyframes before and after the playhead
+uniform bool lavaPlayback;
+uniform sampler2D lavaFrame;
+uniform sampler2D nextLavaFrame;
+uniform float lavaBlend;
+uniform float cellSize;
 
 void main()
 {
-    FragPos = vec3(model * vec4(aPos, 1.0f));
-    Normal = mat3(transpose(inverse(model))) * aNormal;
+    vec3 position = aPos;
     RedValue = aRedValue;
+    if (RedValue.x != 0.0f)
+        RedValue.x = (RedValue.x - temperatureRange.x) / (temperatureRange.y - temperatureRange.x);
+    if (lavaPlayback)
+    {
+        // a corner takes the lava of the cell above and to its left, like the static mesh
+        ivec2 frameSize = textureSize(lavaFrame, 0);
+        ivec2 cell = clamp(ivec2(round(aPos.x / cellSize), round(aPos.z / cellSize)) - 1, ivec2(0), frameSize - 1);
+        vec2 lava = texelFetch(lavaFrame, cell, 0).rg;
+        vec2 nextLava = texelFetch(nextLavaFrame, cell, 0).rg;
+        float thickness = mix(lava.r, nextLava.r, lavaBlend);
+
+        // where the flow is arriving or leaving take the temperature of the keyframe with lava
+        float temperature = mix(lava.g, nextLava.g, lavaBlend);
+        if (lava.r == 0.0f)
+            temperature = nextLava.g;
+        else if (nextLava.r == 0.0f)
+            temperature = lava.g;
+
+        position.y += thickness;
+        RedValue = thickness > 0.0f ? vec3(temperature, 0.0f, 0.0f) : vec3(0.0f);
+    }
+
+    FragPos = vec3(model * vec4(position, 1.0f));
+    Normal = mat3(transpose(inverse(model))) * aNormal;
     TexCoord = aTexCoord;
     
-	gl_Position = projection * view * model * vec4(aPos, 1.0);
+	gl_Position = projection * view * model * vec4(position, 1.0);
 	//gl_Position = vec4(aPos, 1.0);
 }
 